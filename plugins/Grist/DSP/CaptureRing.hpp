@@ -0,0 +1,62 @@
+/*
+ * Grist — Live-input capture ring
+ *
+ * The live-input build (plugins/GristLive) granulates its stereo input.
+ * The audio thread writes each input frame into a ring of `frames`
+ * interleaved stereo frames, and grains read the same memory in place.
+ *
+ * The ring is stored twice back to back: frame i is written at i and at
+ * i + frames. A grain starting in the first copy therefore reads up to a
+ * whole ring length forward, taps across the wrap included, as one plain
+ * contiguous buffer: the grain kernels and their interpolation need no
+ * wrap logic, and nothing is copied per block.
+ */
+
+#ifndef CAPTURE_RING_HPP_INCLUDED
+#define CAPTURE_RING_HPP_INCLUDED
+
+#include "GrainInterp.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Audio thread: appends n input frames at `head`, advancing it (mod frames) and `filled`
+// (saturating at frames). `ring` holds 2 * frames interleaved stereo frames.
+static inline void captureRingWrite(float* ring, uint32_t frames, uint32_t& head, uint32_t& filled,
+                                    const float* inL, const float* inR, uint32_t n)
+{
+    float* const mirror = ring + (size_t)frames * 2;
+    uint32_t h = head;
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        const size_t k = (size_t)h * 2;
+        ring[k] = mirror[k] = inL[i];
+        ring[k + 1] = mirror[k + 1] = inR[i];
+        if (++h == frames)
+            h = 0;
+    }
+    head = h;
+    filled = (uint32_t)std::min<uint64_t>((uint64_t)filled + n, frames);
+}
+
+// Start frame (in [reach, frames + reach), reach = kGrainInterpMaxBefore) of a grain that
+// reads `span` frames and ends `back` (0..1 of the captured history still available to it)
+// behind the write head. Its last tap is behind the head at spawn, so the grain never
+// overtakes it. `lifetime` is how far the head can advance while the grain plays (its
+// duration in output frames plus block slack): that much history is held back, so the
+// oldest tap the grain still has to read is never overwritten. A ring too short for both
+// keeps the first guarantee.
+static inline double captureGrainStart(uint32_t frames, uint32_t head, uint32_t filled, double back, double span,
+                                       double lifetime)
+{
+    const double before = (double)kGrainInterpMaxBefore;
+    const double after = (double)kGrainInterpMaxAfter + 1.0;
+    const double history = std::max(0.0, (double)filled - span - before - after - lifetime);
+    double start = (double)head - span - after - back * history;
+    if (start < before)
+        start += std::ceil((before - start) / (double)frames) * (double)frames;
+    return start;
+}
+
+#endif // CAPTURE_RING_HPP_INCLUDED
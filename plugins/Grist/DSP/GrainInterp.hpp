@@ -0,0 +1,233 @@
+/*
+ * Grist — Grain interpolation
+ *
+ * How a grain reads between source frames. Linear (2 taps), cubic Hermite
+ * (4-tap Catmull-Rom), and 8- or 16-tap Kaiser-windowed sinc. The sinc
+ * modes are polyphase: coefficients for 2^kPhaseBits fractional phases
+ * are precomputed. The top bits of a grain's fixed-point fraction pick
+ * the phase row, and the remaining bits blend it with the next row.
+ *
+ * Taps for frame idx are idx - kBefore .. idx - kBefore + kTaps - 1.
+ * Reads past either end of the source repeat the edge frame.
+ */
+
+#ifndef GRAIN_INTERP_HPP_INCLUDED
+#define GRAIN_INTERP_HPP_INCLUDED
+
+#include "GrainPhase.hpp"
+#include "Kaiser.hpp"
+#include "SampleFormat.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+enum GrainInterp {
+    kInterpLinear = 0,
+    kInterpCubic,
+    kInterpSinc8,
+    kInterpSinc16,
+    kInterpAuto,      // per grain, from its increment (grainInterpForIncrement)
+    kInterpModeCount
+};
+
+template <GrainInterp kInterp> struct GrainInterpTaps;
+template <> struct GrainInterpTaps<kInterpLinear> { static constexpr uint32_t kTaps = 2, kBefore = 0; };
+template <> struct GrainInterpTaps<kInterpCubic> { static constexpr uint32_t kTaps = 4, kBefore = 1; };
+template <> struct GrainInterpTaps<kInterpSinc8> { static constexpr uint32_t kTaps = 8, kBefore = 3; };
+template <> struct GrainInterpTaps<kInterpSinc16> { static constexpr uint32_t kTaps = 16, kBefore = 7; };
+
+// Widest reach of any mode around the read frame (paged and ring sources keep this much margin).
+static constexpr uint32_t kGrainInterpMaxBefore = 7;
+static constexpr uint32_t kGrainInterpMaxAfter = 8;
+
+// Auto mode: unit-rate grains start on a whole frame and read it directly (linear at phase 0
+// is exact); pitched-down grains stretch interpolation images into the audible band and get
+// the long sinc; pitched-up grains (already band-limited by the mips) get the short one.
+static inline GrainInterp grainInterpForIncrement(const GrainPhase inc)
+{
+    const GrainPhase unit = grainPhaseFromIndex(1);
+    return inc == unit ? kInterpLinear : (inc < unit ? kInterpSinc16 : kInterpSinc8);
+}
+
+static inline float catmullRom(const float y0, const float y1, const float y2, const float y3, const float t)
+{
+    // Catmull-Rom spline (cubic), reasonably good for sample playback
+    const float t2 = t * t;
+    const float t3 = t2 * t;
+    return 0.5f * ((2.0f * y1) + (-y0 + y2) * t + (2.0f*y0 - 5.0f*y1 + 4.0f*y2 - y3) * t2 + (-y0 + 3.0f*y1 - 3.0f*y2 + y3) * t3);
+}
+
+class GrainSincTables {
+public:
+    static constexpr uint32_t kPhaseBits = 8;
+    static constexpr uint32_t kPhases = 1u << kPhaseBits;
+
+    GrainSincTables() {
+        build(8, 0.45, 7.0, coef8[0], delta8[0]);
+        build(16, 0.47, 8.6, coef16[0], delta16[0]);
+    }
+
+    // Shared, read-only after construction. Touch it once off the audio thread to build it.
+    static const GrainSincTables& instance() {
+        static const GrainSincTables t;
+        return t;
+    }
+
+    // Coefficients for `phase`'s fraction: row + (next row - row) * blend.
+    template <uint32_t kTaps>
+    inline void coefficients(const GrainPhase phase, float* c) const {
+        const uint32_t row = grainPhaseTableRow<kPhaseBits>(phase);
+        const float blend = (float)((uint32_t)(grainPhaseFrac(phase) << kPhaseBits) >> 8) * (1.0f / 16777216.0f);
+        const float* const a = kTaps == 8 ? coef8[row] : coef16[row];
+        const float* const d = kTaps == 8 ? delta8[row] : delta16[row];
+        for (uint32_t k = 0; k < kTaps; ++k)
+            c[k] = a[k] + d[k] * blend;
+    }
+
+private:
+    // cutoff: fraction of the sample rate; beta: Kaiser window shape. Each row sums to 1.
+    static void build(const uint32_t taps, const double cutoff, const double beta, float* coef, float* delta) {
+        const KaiserSinc kernel(2.0 * cutoff, (double)(taps / 2), beta);
+        const uint32_t before = taps / 2 - 1;
+        double row[kPhases + 1][16];
+
+        for (uint32_t r = 0; r <= kPhases; ++r)
+        {
+            const double frac = (double)r / (double)kPhases;
+            double sum = 0.0;
+            for (uint32_t k = 0; k < taps; ++k)
+            {
+                row[r][k] = kernel((double)k - (double)before - frac);
+                sum += row[r][k];
+            }
+            for (uint32_t k = 0; k < taps; ++k)
+                row[r][k] /= sum;
+        }
+
+        for (uint32_t r = 0; r < kPhases; ++r)
+            for (uint32_t k = 0; k < taps; ++k)
+            {
+                coef[r * taps + k] = (float)row[r][k];
+                delta[r * taps + k] = (float)(row[r + 1][k] - row[r][k]);
+            }
+    }
+
+    alignas(32) float coef8[kPhases][8];
+    alignas(32) float delta8[kPhases][8];
+    alignas(32) float coef16[kPhases][16];
+    alignas(32) float delta16[kPhases][16];
+};
+
+// Reads the kTaps taps around frame idx of a source with `len` frames, `st` elements apart.
+template <SampleFormat kFormat, GrainInterp kInterp>
+static inline void gatherGrainTaps(const typename SampleCodec<kFormat>::Storage* src, const size_t idx,
+                                   const size_t st, const size_t len, float* y)
+{
+    typedef SampleCodec<kFormat> Codec;
+    constexpr uint32_t kTaps = GrainInterpTaps<kInterp>::kTaps;
+    constexpr uint32_t kBefore = GrainInterpTaps<kInterp>::kBefore;
+
+    if (idx >= kBefore && idx - kBefore + kTaps <= len)
+    {
+        const size_t base = (idx - kBefore) * st;
+        for (uint32_t k = 0; k < kTaps; ++k)
+            y[k] = Codec::load(src, base + k * st);
+    }
+    else
+    {
+        for (uint32_t k = 0; k < kTaps; ++k)
+        {
+            const ptrdiff_t j = (ptrdiff_t)idx - (ptrdiff_t)kBefore + (ptrdiff_t)k;
+            const size_t f = j < 0 ? 0 : ((size_t)j >= len ? len - 1 : (size_t)j);
+            y[k] = Codec::load(src, f * st);
+        }
+    }
+}
+
+// Interpolates gathered taps (one or two channels, sharing the phase's coefficients).
+template <GrainInterp kInterp>
+struct GrainTapInterpolator {
+    template <bool kStereo>
+    static inline void run(const float* yL, const float* yR, const GrainPhase phase, const GrainSincTables& sinc,
+                           float& l, float& r)
+    {
+        constexpr uint32_t kTaps = GrainInterpTaps<kInterp>::kTaps;
+        float c[kTaps];
+        sinc.coefficients<kTaps>(phase, c);
+        float accL = 0.0f, accR = 0.0f;
+        for (uint32_t k = 0; k < kTaps; ++k)
+        {
+            accL += yL[k] * c[k];
+            if (kStereo)
+                accR += yR[k] * c[k];
+        }
+        l = accL;
+        r = kStereo ? accR : accL;
+    }
+};
+
+template <>
+struct GrainTapInterpolator<kInterpLinear> {
+    template <bool kStereo>
+    static inline void run(const float* yL, const float* yR, const GrainPhase phase, const GrainSincTables&,
+                           float& l, float& r)
+    {
+        const float t = grainPhaseFracFloat(phase);
+        l = yL[0] + (yL[1] - yL[0]) * t;
+        r = kStereo ? yR[0] + (yR[1] - yR[0]) * t : l;
+    }
+};
+
+template <>
+struct GrainTapInterpolator<kInterpCubic> {
+    template <bool kStereo>
+    static inline void run(const float* yL, const float* yR, const GrainPhase phase, const GrainSincTables&,
+                           float& l, float& r)
+    {
+        const float t = grainPhaseFracFloat(phase);
+        l = catmullRom(yL[0], yL[1], yL[2], yL[3], t);
+        r = kStereo ? catmullRom(yR[0], yR[1], yR[2], yR[3], t) : l;
+    }
+};
+
+// One grain's read at frame idx / phase from planar or interleaved storage. kInterpAuto
+// reads with the grain's own mode (`mode`, GrainPool::interp); other modes ignore it.
+template <SampleFormat kFormat, bool kStereo, GrainInterp kInterp>
+struct GrainReader {
+    static inline void read(uint32_t, const void* L, const void* R, const size_t idx, const GrainPhase phase,
+                            const size_t st, const size_t len, const GrainSincTables& sinc, float& l, float& r)
+    {
+        typedef typename SampleCodec<kFormat>::Storage Storage;
+        constexpr uint32_t kTaps = GrainInterpTaps<kInterp>::kTaps;
+        float yL[kTaps], yR[kTaps];
+        gatherGrainTaps<kFormat, kInterp>(static_cast<const Storage*>(L), idx, st, len, yL);
+        if (kStereo)
+            gatherGrainTaps<kFormat, kInterp>(static_cast<const Storage*>(R), idx, st, len, yR);
+        GrainTapInterpolator<kInterp>::template run<kStereo>(yL, yR, phase, sinc, l, r);
+    }
+};
+
+template <SampleFormat kFormat, bool kStereo>
+struct GrainReader<kFormat, kStereo, kInterpAuto> {
+    static inline void read(const uint32_t mode, const void* L, const void* R, const size_t idx, const GrainPhase phase,
+                            const size_t st, const size_t len, const GrainSincTables& sinc, float& l, float& r)
+    {
+        switch (mode)
+        {
+        case kInterpLinear:
+            GrainReader<kFormat, kStereo, kInterpLinear>::read(mode, L, R, idx, phase, st, len, sinc, l, r);
+            break;
+        case kInterpSinc8:
+            GrainReader<kFormat, kStereo, kInterpSinc8>::read(mode, L, R, idx, phase, st, len, sinc, l, r);
+            break;
+        case kInterpSinc16:
+            GrainReader<kFormat, kStereo, kInterpSinc16>::read(mode, L, R, idx, phase, st, len, sinc, l, r);
+            break;
+        default:
+            GrainReader<kFormat, kStereo, kInterpCubic>::read(mode, L, R, idx, phase, st, len, sinc, l, r);
+            break;
+        }
+    }
+};
+
+#endif // GRAIN_INTERP_HPP_INCLUDED
@@ -0,0 +1,602 @@
+/*
+ * Grist — Grain render kernels
+ *
+ * Renders one live grain of a GrainPool over a span of frames: interpolated
+ * read of the source (GrainInterp.hpp), window lookup and pan, added into
+ * the caller's bus; then advances the grain. The grain's state stays in
+ * registers for the whole span, and the voice envelope is applied to the
+ * bus afterwards, once per span.
+ *
+ * grainKernelScalar is the reference. The SSE2/AVX2 (x86, chosen at runtime)
+ * and NEON (aarch64) kernels render 4 or 8 consecutive frames per iteration
+ * and must match it within float rounding.
+ *
+ * Every kernel comes in a stereo and a mono instantiation (kStereo): mono
+ * sources are interpolated once and the result is panned to both outputs.
+ * It is also instantiated per in-memory SampleFormat; 16-bit taps are
+ * decoded as they are gathered. And per GrainInterp mode: linear and cubic
+ * interpolate the frames in vector registers; the sinc modes run each
+ * frame's dot product in turn, vectorising only window and gain. The
+ * kInterpAuto instantiation reads with the grain's own mode
+ * (GrainPool::interp).
+ *
+ * Each grain reads one mip level of the source (GrainPool::level; its pos
+ * and inc are 32.32 fixed-point frames of that level, see GrainPhase.hpp).
+ * Index and fraction come straight from the phase words, and grains
+ * advance by integer adds. Callers only render frames a grain is live for
+ * (age < dur and idx + 1 < len[level] on each of them); source length must
+ * stay below 2^31 frames.
+ */
+
+#ifndef GRAIN_KERNEL_HPP_INCLUDED
+#define GRAIN_KERNEL_HPP_INCLUDED
+
+#include "GrainInterp.hpp"
+#include "GrainPool.hpp"
+#include "GrainWindow.hpp"
+#include "SampleFormat.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define GRAIN_KERNEL_X86 1
+# include <immintrin.h>
+#elif defined(__aarch64__)
+# define GRAIN_KERNEL_NEON 1
+# include <arm_neon.h>
+#endif
+
+class SampleStream;
+
+// Octave-decimated copies of the source; a grain reads the level GrainPool::level names.
+static constexpr uint32_t kGrainMipLevels = 5;
+
+struct GrainKernelArgs {
+    const void* L[kGrainMipLevels]; // source channels per mip level, SampleCodec<format>::Storage elements
+    const void* R[kGrainMipLevels];
+    size_t len[kGrainMipLevels];    // frames per mip level
+    size_t stride;           // elements between consecutive frames (1 planar, 2 interleaved stereo)
+    const float* window;     // GrainWindowTable data for the current shape
+    const SampleStream* stream; // paged source (grainKernelStreamed only)
+    const GrainSincTables* sinc; // polyphase coefficients (sinc and auto modes)
+};
+
+// Renders grain g for n frames, adding into busL/busR[0, n), and advances it by n frames.
+typedef void (*GrainKernelFn)(GrainPool& pool, uint32_t g, const GrainKernelArgs& a, uint32_t n, float* busL, float* busR);
+
+struct GrainKernels {
+    GrainKernelFn fn[kInterpModeCount][kSampleFormatCount][2]; // [interp][format][stereo]
+
+    GrainKernelFn select(GrainInterp interp, SampleFormat format, uint32_t channels) const
+    {
+        return fn[interp][format][channels == 2 ? 1 : 0];
+    }
+};
+
+#define GRAIN_KERNEL_FORMATS(k, i) { { k<kSampleFloat32, false, i>, k<kSampleFloat32, true, i> }, \
+                                     { k<kSampleInt16, false, i>, k<kSampleInt16, true, i> }, \
+                                     { k<kSampleHalf, false, i>, k<kSampleHalf, true, i> } }
+
+#define GRAIN_KERNEL_TABLE(k) { { GRAIN_KERNEL_FORMATS(k, kInterpLinear), GRAIN_KERNEL_FORMATS(k, kInterpCubic), \
+                                  GRAIN_KERNEL_FORMATS(k, kInterpSinc8), GRAIN_KERNEL_FORMATS(k, kInterpSinc16), \
+                                  GRAIN_KERNEL_FORMATS(k, kInterpAuto) } }
+
+// One frame of a grain at phase `pos` / window position `winPos` (reference path, also used for vector tails).
+template <SampleFormat kFormat, bool kStereo, GrainInterp kInterp>
+static inline void grainKernelFrame(const GrainKernelArgs& a, uint32_t lv, uint32_t mode, GrainPhase pos, float winPos,
+                                    float gainL, float gainR, float& busL, float& busR)
+{
+    float l, r;
+    GrainReader<kFormat, kStereo, kInterp>::read(mode, a.L[lv], a.R[lv], grainPhaseIndex(pos), pos,
+                                                 a.stride, a.len[lv], *a.sinc, l, r);
+
+    const float w = GrainWindowTable::read(a.window, winPos);
+    busL += l * w * gainL;
+    busR += r * w * gainR;
+}
+
+template <SampleFormat kFormat, bool kStereo, GrainInterp kInterp>
+static void grainKernelScalar(GrainPool& p, uint32_t g, const GrainKernelArgs& a, uint32_t n, float* busL, float* busR)
+{
+    typedef SampleCodec<kFormat> Codec;
+
+    const uint32_t lv = p.level[g];
+    const uint32_t mode = p.interp[g];
+    const GrainPhase inc = p.inc[g];
+    const float winInc = p.winInc[g];
+    const float gainL = p.gainL[g] * Codec::kScale;
+    const float gainR = p.gainR[g] * Codec::kScale;
+
+    GrainPhase pos = p.pos[g];
+    float winPos = p.winPos[g];
+    for (uint32_t k = 0; k < n; ++k)
+    {
+        grainKernelFrame<kFormat, kStereo, kInterp>(a, lv, mode, pos, winPos, gainL, gainR, busL[k], busR[k]);
+        pos += inc;
+        winPos += winInc;
+    }
+
+    p.pos[g] = pos;
+    p.winPos[g] = winPos;
+    p.age[g] += n;
+}
+
+#if defined(GRAIN_KERNEL_X86)
+
+__attribute__((target("sse2")))
+static inline __m128 catmullRom4(const __m128 y0, const __m128 y1, const __m128 y2, const __m128 y3, const __m128 t)
+{
+    const __m128 t2 = _mm_mul_ps(t, t);
+    const __m128 t3 = _mm_mul_ps(t2, t);
+    const __m128 c1 = _mm_sub_ps(y2, y0);
+    const __m128 c2 = _mm_sub_ps(_mm_add_ps(_mm_sub_ps(_mm_add_ps(y0, y0), _mm_mul_ps(_mm_set1_ps(5.0f), y1)),
+                                            _mm_mul_ps(_mm_set1_ps(4.0f), y2)), y3);
+    const __m128 c3 = _mm_add_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.0f), y1), y0),
+                                            _mm_mul_ps(_mm_set1_ps(3.0f), y2)), y3);
+    const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(y1, y1), _mm_mul_ps(c1, t)), _mm_mul_ps(c2, t2)),
+                                  _mm_mul_ps(c3, t3));
+    return _mm_mul_ps(_mm_set1_ps(0.5f), sum);
+}
+
+__attribute__((target("sse2")))
+static inline __m128 lerp4(const __m128 y1, const __m128 y2, const __m128 t)
+{
+    return _mm_add_ps(y1, _mm_mul_ps(_mm_sub_ps(y2, y1), t));
+}
+
+template <SampleFormat kFormat, bool kStereo, GrainInterp kInterp>
+__attribute__((target("sse2")))
+static void grainKernelSSE2(GrainPool& p, uint32_t g, const GrainKernelArgs& a, uint32_t n, float* busL, float* busR)
+{
+    typedef SampleCodec<kFormat> Codec;
+
+    const uint32_t lv = p.level[g];
+    const uint32_t mode = p.interp[g];
+    const typename Codec::Storage* const L = static_cast<const typename Codec::Storage*>(a.L[lv]);
+    const typename Codec::Storage* const R = static_cast<const typename Codec::Storage*>(a.R[lv]);
+    const size_t st = a.stride;
+    const size_t len = a.len[lv];
+    const GrainPhase inc = p.inc[g];
+    const float winInc = p.winInc[g];
+    const float gainL = p.gainL[g] * Codec::kScale;
+    const float gainR = p.gainR[g] * Codec::kScale;
+    const __m128 gl = _mm_set1_ps(gainL);
+    const __m128 gr = _mm_set1_ps(gainR);
+    const __m128i maxW = _mm_set1_epi32((int32_t)GrainWindowTable::kSize - 1);
+
+    GrainPhase pos = p.pos[g];
+    float winPos = p.winPos[g];
+
+    alignas(16) GrainPhase ph[4];
+    alignas(16) float wp[4];
+    alignas(16) int32_t idx[4];
+    alignas(16) int32_t wi[4];
+    alignas(16) float y0L[4], y1L[4], y2L[4], y3L[4];
+    alignas(16) float y0R[4], y1R[4], y2R[4], y3R[4];
+    alignas(16) float w0[4], w1[4];
+
+    uint32_t k = 0;
+    for (; k + 4 <= n; k += 4)
+    {
+        // the grain's next 4 frames, stepped exactly like the scalar path
+        for (uint32_t j = 0; j < 4; ++j)
+        {
+            ph[j] = pos;
+            wp[j] = winPos;
+            pos += inc;
+            winPos += winInc;
+        }
+
+        // source phase -> integer index (high words) + fraction (low words, top 24 bits)
+        const __m128i p01 = _mm_load_si128((const __m128i*)ph);
+        const __m128i p23 = _mm_load_si128((const __m128i*)(ph + 2));
+        const __m128 hi = _mm_shuffle_ps(_mm_castsi128_ps(p01), _mm_castsi128_ps(p23), _MM_SHUFFLE(3, 1, 3, 1));
+        const __m128 lo = _mm_shuffle_ps(_mm_castsi128_ps(p01), _mm_castsi128_ps(p23), _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 frac = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(_mm_castps_si128(lo), 8)), _mm_set1_ps(1.0f / 16777216.0f));
+        _mm_store_si128((__m128i*)idx, _mm_castps_si128(hi));
+
+        // window position -> table index + fraction (clamped like GrainWindowTable::read)
+        const __m128 wv = _mm_load_ps(wp);
+        __m128i wpi = _mm_cvttps_epi32(wv);
+        const __m128i over = _mm_cmpgt_epi32(wpi, maxW);
+        wpi = _mm_or_si128(_mm_and_si128(over, maxW), _mm_andnot_si128(over, wpi));
+        const __m128 wfrac = _mm_min_ps(_mm_sub_ps(wv, _mm_cvtepi32_ps(wpi)), _mm_set1_ps(1.0f));
+        _mm_store_si128((__m128i*)wi, wpi);
+
+        // gather (scalar loads: faster than hardware gathers on many cores, identical results)
+        for (uint32_t j = 0; j < 4; ++j)
+        {
+            if (kInterp == kInterpLinear || kInterp == kInterpCubic)
+            {
+                const size_t i1 = (size_t)idx[j] * st;
+                const size_t i2 = i1 + st;
+                y1L[j] = Codec::load(L, i1); y2L[j] = Codec::load(L, i2);
+                if (kStereo)
+                {
+                    y1R[j] = Codec::load(R, i1); y2R[j] = Codec::load(R, i2);
+                }
+                if (kInterp == kInterpCubic)
+                {
+                    const size_t i0 = (idx[j] > 0) ? (i1 - st) : i1;
+                    const size_t i3 = ((size_t)idx[j] + 2 < len) ? (i2 + st) : i2;
+                    y0L[j] = Codec::load(L, i0); y3L[j] = Codec::load(L, i3);
+                    if (kStereo)
+                    {
+                        y0R[j] = Codec::load(R, i0); y3R[j] = Codec::load(R, i3);
+                    }
+                }
+            }
+            else
+            {
+                // sinc / per-grain mode: the whole read, one frame at a time; result in y1
+                GrainReader<kFormat, kStereo, kInterp>::read(mode, L, R, (size_t)idx[j], ph[j], st, len, *a.sinc,
+                                                             y1L[j], y1R[j]);
+            }
+            w0[j] = a.window[wi[j]];
+            w1[j] = a.window[wi[j] + 1];
+        }
+
+        __m128 l, r;
+        if (kInterp == kInterpCubic)
+        {
+            l = catmullRom4(_mm_load_ps(y0L), _mm_load_ps(y1L), _mm_load_ps(y2L), _mm_load_ps(y3L), frac);
+            r = kStereo ? catmullRom4(_mm_load_ps(y0R), _mm_load_ps(y1R), _mm_load_ps(y2R), _mm_load_ps(y3R), frac) : l;
+        }
+        else if (kInterp == kInterpLinear)
+        {
+            l = lerp4(_mm_load_ps(y1L), _mm_load_ps(y2L), frac);
+            r = kStereo ? lerp4(_mm_load_ps(y1R), _mm_load_ps(y2R), frac) : l;
+        }
+        else
+        {
+            l = _mm_load_ps(y1L);
+            r = kStereo ? _mm_load_ps(y1R) : l;
+        }
+
+        const __m128 wa = _mm_load_ps(w0);
+        const __m128 w = _mm_add_ps(wa, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(w1), wa), wfrac));
+
+        _mm_storeu_ps(busL + k, _mm_add_ps(_mm_loadu_ps(busL + k), _mm_mul_ps(_mm_mul_ps(l, w), gl)));
+        _mm_storeu_ps(busR + k, _mm_add_ps(_mm_loadu_ps(busR + k), _mm_mul_ps(_mm_mul_ps(r, w), gr)));
+    }
+
+    for (; k < n; ++k)
+    {
+        grainKernelFrame<kFormat, kStereo, kInterp>(a, lv, mode, pos, winPos, gainL, gainR, busL[k], busR[k]);
+        pos += inc;
+        winPos += winInc;
+    }
+
+    p.pos[g] = pos;
+    p.winPos[g] = winPos;
+    p.age[g] += n;
+}
+
+__attribute__((target("avx2")))
+static inline __m256 catmullRom8(const __m256 y0, const __m256 y1, const __m256 y2, const __m256 y3, const __m256 t)
+{
+    const __m256 t2 = _mm256_mul_ps(t, t);
+    const __m256 t3 = _mm256_mul_ps(t2, t);
+    const __m256 c1 = _mm256_sub_ps(y2, y0);
+    const __m256 c2 = _mm256_sub_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_add_ps(y0, y0), _mm256_mul_ps(_mm256_set1_ps(5.0f), y1)),
+                                                  _mm256_mul_ps(_mm256_set1_ps(4.0f), y2)), y3);
+    const __m256 c3 = _mm256_add_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(3.0f), y1), y0),
+                                                  _mm256_mul_ps(_mm256_set1_ps(3.0f), y2)), y3);
+    const __m256 sum = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(y1, y1), _mm256_mul_ps(c1, t)), _mm256_mul_ps(c2, t2)),
+                                     _mm256_mul_ps(c3, t3));
+    return _mm256_mul_ps(_mm256_set1_ps(0.5f), sum);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 lerp8(const __m256 y1, const __m256 y2, const __m256 t)
+{
+    return _mm256_add_ps(y1, _mm256_mul_ps(_mm256_sub_ps(y2, y1), t));
+}
+
+template <SampleFormat kFormat, bool kStereo, GrainInterp kInterp>
+__attribute__((target("avx2")))
+static void grainKernelAVX2(GrainPool& p, uint32_t g, const GrainKernelArgs& a, uint32_t n, float* busL, float* busR)
+{
+    typedef SampleCodec<kFormat> Codec;
+
+    const uint32_t lv = p.level[g];
+    const uint32_t mode = p.interp[g];
+    const typename Codec::Storage* const L = static_cast<const typename Codec::Storage*>(a.L[lv]);
+    const typename Codec::Storage* const R = static_cast<const typename Codec::Storage*>(a.R[lv]);
+    const size_t st = a.stride;
+    const size_t len = a.len[lv];
+    const GrainPhase inc = p.inc[g];
+    const float winInc = p.winInc[g];
+    const float gainL = p.gainL[g] * Codec::kScale;
+    const float gainR = p.gainR[g] * Codec::kScale;
+    const __m256 gl = _mm256_set1_ps(gainL);
+    const __m256 gr = _mm256_set1_ps(gainR);
+    const __m256i maxW = _mm256_set1_epi32((int32_t)GrainWindowTable::kSize - 1);
+
+    GrainPhase pos = p.pos[g];
+    float winPos = p.winPos[g];
+
+    alignas(32) GrainPhase ph[8];
+    alignas(32) float wp[8];
+    alignas(32) int32_t idx[8];
+    alignas(32) int32_t wi[8];
+    alignas(32) float y0L[8], y1L[8], y2L[8], y3L[8];
+    alignas(32) float y0R[8], y1R[8], y2R[8], y3R[8];
+    alignas(32) float w0[8], w1[8];
+
+    uint32_t k = 0;
+    for (; k + 8 <= n; k += 8)
+    {
+        // the grain's next 8 frames, stepped exactly like the scalar path
+        for (uint32_t j = 0; j < 8; ++j)
+        {
+            ph[j] = pos;
+            wp[j] = winPos;
+            pos += inc;
+            winPos += winInc;
+        }
+
+        // source phase -> integer index (high words) + fraction (low words, top 24 bits);
+        // the in-lane shuffle leaves 64-bit chunks as {0,1} {4,5} {2,3} {6,7}, the permute restores frame order
+        const __m256i p0 = _mm256_load_si256((const __m256i*)ph);
+        const __m256i p1 = _mm256_load_si256((const __m256i*)(ph + 4));
+        const __m256i hi = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(
+            _mm256_castsi256_ps(p0), _mm256_castsi256_ps(p1), _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m256i lo = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(
+            _mm256_castsi256_ps(p0), _mm256_castsi256_ps(p1), _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m256 frac = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(lo, 8)), _mm256_set1_ps(1.0f / 16777216.0f));
+        _mm256_store_si256((__m256i*)idx, hi);
+
+        // window position -> table index + fraction (clamped like GrainWindowTable::read)
+        const __m256 wv = _mm256_load_ps(wp);
+        const __m256i wpi = _mm256_min_epi32(_mm256_cvttps_epi32(wv), maxW);
+        const __m256 wfrac = _mm256_min_ps(_mm256_sub_ps(wv, _mm256_cvtepi32_ps(wpi)), _mm256_set1_ps(1.0f));
+        _mm256_store_si256((__m256i*)wi, wpi);
+
+        // gather (scalar loads: faster than hardware gathers on many cores, identical results)
+        for (uint32_t j = 0; j < 8; ++j)
+        {
+            if (kInterp == kInterpLinear || kInterp == kInterpCubic)
+            {
+                const size_t i1 = (size_t)idx[j] * st;
+                const size_t i2 = i1 + st;
+                y1L[j] = Codec::load(L, i1); y2L[j] = Codec::load(L, i2);
+                if (kStereo)
+                {
+                    y1R[j] = Codec::load(R, i1); y2R[j] = Codec::load(R, i2);
+                }
+                if (kInterp == kInterpCubic)
+                {
+                    const size_t i0 = (idx[j] > 0) ? (i1 - st) : i1;
+                    const size_t i3 = ((size_t)idx[j] + 2 < len) ? (i2 + st) : i2;
+                    y0L[j] = Codec::load(L, i0); y3L[j] = Codec::load(L, i3);
+                    if (kStereo)
+                    {
+                        y0R[j] = Codec::load(R, i0); y3R[j] = Codec::load(R, i3);
+                    }
+                }
+            }
+            else
+            {
+                // sinc / per-grain mode: the whole read, one frame at a time; result in y1
+                GrainReader<kFormat, kStereo, kInterp>::read(mode, L, R, (size_t)idx[j], ph[j], st, len, *a.sinc,
+                                                             y1L[j], y1R[j]);
+            }
+            w0[j] = a.window[wi[j]];
+            w1[j] = a.window[wi[j] + 1];
+        }
+
+        __m256 l, r;
+        if (kInterp == kInterpCubic)
+        {
+            l = catmullRom8(_mm256_load_ps(y0L), _mm256_load_ps(y1L), _mm256_load_ps(y2L), _mm256_load_ps(y3L), frac);
+            r = kStereo ? catmullRom8(_mm256_load_ps(y0R), _mm256_load_ps(y1R), _mm256_load_ps(y2R), _mm256_load_ps(y3R), frac) : l;
+        }
+        else if (kInterp == kInterpLinear)
+        {
+            l = lerp8(_mm256_load_ps(y1L), _mm256_load_ps(y2L), frac);
+            r = kStereo ? lerp8(_mm256_load_ps(y1R), _mm256_load_ps(y2R), frac) : l;
+        }
+        else
+        {
+            l = _mm256_load_ps(y1L);
+            r = kStereo ? _mm256_load_ps(y1R) : l;
+        }
+
+        const __m256 wa = _mm256_load_ps(w0);
+        const __m256 w = _mm256_add_ps(wa, _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(w1), wa), wfrac));
+
+        _mm256_storeu_ps(busL + k, _mm256_add_ps(_mm256_loadu_ps(busL + k), _mm256_mul_ps(_mm256_mul_ps(l, w), gl)));
+        _mm256_storeu_ps(busR + k, _mm256_add_ps(_mm256_loadu_ps(busR + k), _mm256_mul_ps(_mm256_mul_ps(r, w), gr)));
+    }
+
+    // the tail runs non-VEX scalar code: clear upper YMM state first to avoid transition stalls
+    _mm256_zeroupper();
+    for (; k < n; ++k)
+    {
+        grainKernelFrame<kFormat, kStereo, kInterp>(a, lv, mode, pos, winPos, gainL, gainR, busL[k], busR[k]);
+        pos += inc;
+        winPos += winInc;
+    }
+
+    p.pos[g] = pos;
+    p.winPos[g] = winPos;
+    p.age[g] += n;
+}
+
+#elif defined(GRAIN_KERNEL_NEON)
+
+static inline float32x4_t catmullRom4(const float32x4_t y0, const float32x4_t y1, const float32x4_t y2, const float32x4_t y3, const float32x4_t t)
+{
+    const float32x4_t t2 = vmulq_f32(t, t);
+    const float32x4_t t3 = vmulq_f32(t2, t);
+    const float32x4_t c1 = vsubq_f32(y2, y0);
+    const float32x4_t c2 = vsubq_f32(vaddq_f32(vsubq_f32(vaddq_f32(y0, y0), vmulq_n_f32(y1, 5.0f)), vmulq_n_f32(y2, 4.0f)), y3);
+    const float32x4_t c3 = vaddq_f32(vsubq_f32(vsubq_f32(vmulq_n_f32(y1, 3.0f), y0), vmulq_n_f32(y2, 3.0f)), y3);
+    const float32x4_t sum = vaddq_f32(vaddq_f32(vaddq_f32(vaddq_f32(y1, y1), vmulq_f32(c1, t)), vmulq_f32(c2, t2)), vmulq_f32(c3, t3));
+    return vmulq_n_f32(sum, 0.5f);
+}
+
+static inline float32x4_t lerp4(const float32x4_t y1, const float32x4_t y2, const float32x4_t t)
+{
+    return vaddq_f32(y1, vmulq_f32(vsubq_f32(y2, y1), t));
+}
+
+template <SampleFormat kFormat, bool kStereo, GrainInterp kInterp>
+static void grainKernelNEON(GrainPool& p, uint32_t g, const GrainKernelArgs& a, uint32_t n, float* busL, float* busR)
+{
+    typedef SampleCodec<kFormat> Codec;
+
+    const uint32_t lv = p.level[g];
+    const uint32_t mode = p.interp[g];
+    const typename Codec::Storage* const L = static_cast<const typename Codec::Storage*>(a.L[lv]);
+    const typename Codec::Storage* const R = static_cast<const typename Codec::Storage*>(a.R[lv]);
+    const size_t st = a.stride;
+    const size_t len = a.len[lv];
+    const GrainPhase inc = p.inc[g];
+    const float winInc = p.winInc[g];
+    const float gainL = p.gainL[g] * Codec::kScale;
+    const float gainR = p.gainR[g] * Codec::kScale;
+    const float32x4_t gl = vdupq_n_f32(gainL);
+    const float32x4_t gr = vdupq_n_f32(gainR);
+
+    GrainPhase pos = p.pos[g];
+    float winPos = p.winPos[g];
+
+    alignas(16) GrainPhase ph[4];
+    alignas(16) float wp[4];
+    alignas(16) int32_t idx[4];
+    alignas(16) int32_t wi[4];
+    alignas(16) float y0L[4], y1L[4], y2L[4], y3L[4];
+    alignas(16) float y0R[4], y1R[4], y2R[4], y3R[4];
+    alignas(16) float w0[4], w1[4];
+
+    uint32_t k = 0;
+    for (; k + 4 <= n; k += 4)
+    {
+        // the grain's next 4 frames, stepped exactly like the scalar path
+        for (uint32_t j = 0; j < 4; ++j)
+        {
+            ph[j] = pos;
+            wp[j] = winPos;
+            pos += inc;
+            winPos += winInc;
+        }
+
+        // source phase -> integer index (high words) + fraction (low words, top 24 bits)
+        const uint64x2_t p01 = vld1q_u64(ph);
+        const uint64x2_t p23 = vld1q_u64(ph + 2);
+        const uint32x4_t lo = vcombine_u32(vmovn_u64(p01), vmovn_u64(p23));
+        const float32x4_t frac = vmulq_n_f32(vcvtq_f32_u32(vshrq_n_u32(lo, 8)), 1.0f / 16777216.0f);
+        vst1q_s32(idx, vreinterpretq_s32_u32(vcombine_u32(vshrn_n_u64(p01, 32), vshrn_n_u64(p23, 32))));
+
+        // window position -> table index + fraction (clamped like GrainWindowTable::read)
+        const float32x4_t wv = vld1q_f32(wp);
+        const int32x4_t wpi = vminq_s32(vcvtq_s32_f32(wv), vdupq_n_s32((int32_t)GrainWindowTable::kSize - 1));
+        const float32x4_t wfrac = vminq_f32(vsubq_f32(wv, vcvtq_f32_s32(wpi)), vdupq_n_f32(1.0f));
+        vst1q_s32(wi, wpi);
+
+        // gather (scalar loads: faster than hardware gathers on many cores, identical results)
+        for (uint32_t j = 0; j < 4; ++j)
+        {
+            if (kInterp == kInterpLinear || kInterp == kInterpCubic)
+            {
+                const size_t i1 = (size_t)idx[j] * st;
+                const size_t i2 = i1 + st;
+                y1L[j] = Codec::load(L, i1); y2L[j] = Codec::load(L, i2);
+                if (kStereo)
+                {
+                    y1R[j] = Codec::load(R, i1); y2R[j] = Codec::load(R, i2);
+                }
+                if (kInterp == kInterpCubic)
+                {
+                    const size_t i0 = (idx[j] > 0) ? (i1 - st) : i1;
+                    const size_t i3 = ((size_t)idx[j] + 2 < len) ? (i2 + st) : i2;
+                    y0L[j] = Codec::load(L, i0); y3L[j] = Codec::load(L, i3);
+                    if (kStereo)
+                    {
+                        y0R[j] = Codec::load(R, i0); y3R[j] = Codec::load(R, i3);
+                    }
+                }
+            }
+            else
+            {
+                // sinc / per-grain mode: the whole read, one frame at a time; result in y1
+                GrainReader<kFormat, kStereo, kInterp>::read(mode, L, R, (size_t)idx[j], ph[j], st, len, *a.sinc,
+                                                             y1L[j], y1R[j]);
+            }
+            w0[j] = a.window[wi[j]];
+            w1[j] = a.window[wi[j] + 1];
+        }
+
+        float32x4_t l, r;
+        if (kInterp == kInterpCubic)
+        {
+            l = catmullRom4(vld1q_f32(y0L), vld1q_f32(y1L), vld1q_f32(y2L), vld1q_f32(y3L), frac);
+            r = kStereo ? catmullRom4(vld1q_f32(y0R), vld1q_f32(y1R), vld1q_f32(y2R), vld1q_f32(y3R), frac) : l;
+        }
+        else if (kInterp == kInterpLinear)
+        {
+            l = lerp4(vld1q_f32(y1L), vld1q_f32(y2L), frac);
+            r = kStereo ? lerp4(vld1q_f32(y1R), vld1q_f32(y2R), frac) : l;
+        }
+        else
+        {
+            l = vld1q_f32(y1L);
+            r = kStereo ? vld1q_f32(y1R) : l;
+        }
+
+        const float32x4_t wa = vld1q_f32(w0);
+        const float32x4_t w = vaddq_f32(wa, vmulq_f32(vsubq_f32(vld1q_f32(w1), wa), wfrac));
+
+        vst1q_f32(busL + k, vaddq_f32(vld1q_f32(busL + k), vmulq_f32(vmulq_f32(l, w), gl)));
+        vst1q_f32(busR + k, vaddq_f32(vld1q_f32(busR + k), vmulq_f32(vmulq_f32(r, w), gr)));
+    }
+
+    for (; k < n; ++k)
+    {
+        grainKernelFrame<kFormat, kStereo, kInterp>(a, lv, mode, pos, winPos, gainL, gainR, busL[k], busR[k]);
+        pos += inc;
+        winPos += winInc;
+    }
+
+    p.pos[g] = pos;
+    p.winPos[g] = winPos;
+    p.age[g] += n;
+}
+
+#endif
+
+// Picks the widest kernels the running CPU supports.
+// GRIST_GRAIN_KERNEL=scalar|sse2|avx2|neon in the environment forces a specific
+// kernel (A/B checks against the scalar reference); unsupported names are ignored.
+static inline GrainKernels selectGrainKernels()
+{
+    const GrainKernels scalar = GRAIN_KERNEL_TABLE(grainKernelScalar);
+
+    const char* const force = std::getenv("GRIST_GRAIN_KERNEL");
+    if (force != nullptr && std::strcmp(force, "scalar") == 0)
+        return scalar;
+
+#if defined(GRAIN_KERNEL_X86)
+    __builtin_cpu_init();
+    const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    const bool hasSSE2 = __builtin_cpu_supports("sse2");
+    const GrainKernels sse2 = GRAIN_KERNEL_TABLE(grainKernelSSE2);
+    if (force != nullptr && std::strcmp(force, "sse2") == 0 && hasSSE2)
+        return sse2;
+    if (hasAVX2)
+        return GRAIN_KERNEL_TABLE(grainKernelAVX2);
+    if (hasSSE2)
+        return sse2;
+#elif defined(GRAIN_KERNEL_NEON)
+    return GRAIN_KERNEL_TABLE(grainKernelNEON);
+#endif
+
+    return scalar;
+}
+
+#endif // GRAIN_KERNEL_HPP_INCLUDED
@@ -0,0 +1,66 @@
+/*
+ * Grist — Fixed-point grain phase
+ *
+ * A grain's read position and increment are 32.32 fixed-point frames:
+ * the integer frame index in the high word and the fraction in the low
+ * word. Advancing is one integer add per frame, exact and free of the
+ * drift a double picks up far from zero, and index/fraction extraction
+ * is a shift and a truncation, with no float->int conversion.
+ *
+ * The fraction is consumed two ways: as a float in [0, 1) (its top 24
+ * bits, exact in a float mantissa), and as a row of a phase-indexed
+ * coefficient table (its top kBits). Positions are limited to 2^32 frames.
+ */
+
+#ifndef GRAIN_PHASE_HPP_INCLUDED
+#define GRAIN_PHASE_HPP_INCLUDED
+
+#include <cstdint>
+
+typedef uint64_t GrainPhase;
+
+static constexpr uint32_t kGrainPhaseFracBits = 32;
+static constexpr double kGrainPhaseOne = 4294967296.0; // 1 frame
+
+// Nearest phase to a non-negative frame position or increment.
+static inline GrainPhase grainPhaseFromFrames(const double frames)
+{
+    return (GrainPhase)(frames * kGrainPhaseOne + 0.5);
+}
+
+static inline GrainPhase grainPhaseFromIndex(const uint64_t index)
+{
+    return (GrainPhase)index << kGrainPhaseFracBits;
+}
+
+static inline double grainPhaseToFrames(const GrainPhase p)
+{
+    return (double)p * (1.0 / kGrainPhaseOne);
+}
+
+static inline uint32_t grainPhaseIndex(const GrainPhase p)
+{
+    return (uint32_t)(p >> kGrainPhaseFracBits);
+}
+
+// Fraction as 0.32 fixed point.
+static inline uint32_t grainPhaseFrac(const GrainPhase p)
+{
+    return (uint32_t)p;
+}
+
+// Fraction as a float in [0, 1): top 24 bits, so SIMD kernels can convert it as a signed int.
+static inline float grainPhaseFracFloat(const GrainPhase p)
+{
+    return (float)(grainPhaseFrac(p) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Row of a table with 2^kBits phases per frame (e.g. polyphase interpolation coefficients).
+template <uint32_t kBits>
+static inline uint32_t grainPhaseTableRow(const GrainPhase p)
+{
+    static_assert(kBits > 0 && kBits <= 24, "table rows must fit the float fraction's precision");
+    return grainPhaseFrac(p) >> (32 - kBits);
+}
+
+#endif // GRAIN_PHASE_HPP_INCLUDED
@@ -0,0 +1,136 @@
+/*
+ * Grist — Grain pool
+ *
+ * One instance-wide pool of grains in structure-of-arrays layout.
+ * Live grains are kept packed in [0, activeCount()): allocation appends and
+ * release moves the last live grain into the freed index, both O(1).
+ * releaseVoice and the renderer's retirement (move + truncate) compact in
+ * place instead, keeping grains in spawn order: the order grains are summed
+ * in then does not depend on when the finished ones were dropped.
+ * The renderer walks only live grains.
+ */
+
+#ifndef GRAIN_POOL_HPP_INCLUDED
+#define GRAIN_POOL_HPP_INCLUDED
+
+#include "GrainPhase.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class GrainPool {
+public:
+    // Allocates all storage up front; nothing allocates after construction.
+    // Capacity is rounded up to a multiple of 8 so vector kernels never read past the end.
+    explicit GrainPool(uint32_t capacity)
+        : cap((capacity + 7u) & ~7u)
+    {
+        pos.resize(cap);
+        startPos.resize(cap);
+        inc.resize(cap);
+        age.resize(cap);
+        dur.resize(cap);
+        winPos.resize(cap);
+        winInc.resize(cap);
+        gainL.resize(cap);
+        gainR.resize(cap);
+        voice.resize(cap);
+        level.resize(cap);
+        interp.resize(cap);
+    }
+
+    void clear() { numActive = 0; }
+
+    uint32_t capacity() const { return cap; }
+    uint32_t activeCount() const { return numActive; }
+    bool full() const { return numActive == cap; }
+
+    // Returns the index of a new live grain, or -1 when the pool is exhausted.
+    int32_t alloc() {
+        if (numActive == cap) return -1;
+        return (int32_t)numActive++;
+    }
+
+    // Moves the last live grain into index `i`, so callers iterating the
+    // live range must not advance after a release.
+    void release(uint32_t i) {
+        const uint32_t last = --numActive;
+        if (i != last)
+            move(i, last);
+    }
+
+    // Copies grain `src` over grain `dst`.
+    void move(uint32_t dst, uint32_t src) {
+        pos[dst] = pos[src];
+        startPos[dst] = startPos[src];
+        inc[dst] = inc[src];
+        age[dst] = age[src];
+        dur[dst] = dur[src];
+        winPos[dst] = winPos[src];
+        winInc[dst] = winInc[src];
+        gainL[dst] = gainL[src];
+        gainR[dst] = gainR[src];
+        voice[dst] = voice[src];
+        level[dst] = level[src];
+        interp[dst] = interp[src];
+    }
+
+    // Keeps only the first n live grains.
+    void truncate(uint32_t n) {
+        if (n < numActive)
+            numActive = n;
+    }
+
+    // Exchanges the contents of two pools of the same capacity (no allocation).
+    void swap(GrainPool& other) {
+        pos.swap(other.pos);
+        startPos.swap(other.startPos);
+        inc.swap(other.inc);
+        age.swap(other.age);
+        dur.swap(other.dur);
+        winPos.swap(other.winPos);
+        winInc.swap(other.winInc);
+        gainL.swap(other.gainL);
+        gainR.swap(other.gainR);
+        voice.swap(other.voice);
+        level.swap(other.level);
+        interp.swap(other.interp);
+        std::swap(cap, other.cap);
+        std::swap(numActive, other.numActive);
+    }
+
+    // Releases every live grain owned by voice `v`.
+    void releaseVoice(uint32_t v) {
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < numActive; ++i)
+        {
+            if (voice[i] == v)
+                continue;
+            if (kept != i)
+                move(kept, i);
+            ++kept;
+        }
+        numActive = kept;
+    }
+
+    // Per-grain state, live grains in [0, activeCount())
+    std::vector<GrainPhase> pos;      // current read position, 32.32 frames of `level`
+    std::vector<GrainPhase> startPos; // start read position, 32.32 frames of `level`
+    std::vector<GrainPhase> inc;      // playback increment per output sample, 32.32 frames of `level`
+    std::vector<uint32_t> age;        // samples rendered
+    std::vector<uint32_t> dur;        // duration in output samples
+    std::vector<float> winPos;        // window table position
+    std::vector<float> winInc;        // window table step per output sample
+    std::vector<float> gainL;         // pan * size normalization
+    std::vector<float> gainR;
+    std::vector<uint32_t> voice;      // owning voice index
+    std::vector<uint32_t> level;      // source mip level (0: full rate)
+    std::vector<uint32_t> interp;     // GrainInterp mode (read by kInterpAuto kernels)
+
+private:
+    uint32_t cap;
+    uint32_t numActive = 0;
+};
+
+#endif // GRAIN_POOL_HPP_INCLUDED
@@ -0,0 +1,97 @@
+/*
+ * Grist — Grain window tables
+ *
+ * Precomputed grain envelopes, read with linear interpolation.
+ * Grains step a table position incrementally (no per-sample cos/divide).
+ */
+
+#ifndef GRAIN_WINDOW_HPP_INCLUDED
+#define GRAIN_WINDOW_HPP_INCLUDED
+
+#include <cmath>
+#include <cstdint>
+
+enum GrainWindowShape {
+    kWindowHann = 0,
+    kWindowTukey,
+    kWindowGaussian,
+    kWindowTrapezoid,
+    kWindowShapeCount
+};
+
+class GrainWindowTable {
+public:
+    // Table resolution; each shape stores kSize + 1 points (last one is the guard for interpolation).
+    static constexpr uint32_t kSize = 1024;
+
+    GrainWindowTable() {
+        for (uint32_t s = 0; s < kWindowShapeCount; ++s)
+            for (uint32_t i = 0; i <= kSize; ++i)
+                table[s][i] = (float)evaluate(s, (double)i / (double)kSize);
+    }
+
+    // Shared, read-only after construction. Touch it once off the audio thread to build it.
+    static const GrainWindowTable& instance() {
+        static const GrainWindowTable t;
+        return t;
+    }
+
+    const float* data(uint32_t shape) const {
+        return table[shape < (uint32_t)kWindowShapeCount ? shape : (uint32_t)kWindowHann];
+    }
+
+    // Table-position increment per output sample for a grain of `dur` samples,
+    // so that position kSize is reached on the last sample.
+    static float stepForDuration(uint32_t dur) {
+        return (dur > 1) ? (float)kSize / (float)(dur - 1) : (float)kSize;
+    }
+
+    // Interpolated read at table position `x` (0..kSize).
+    static inline float read(const float* t, float x) {
+        uint32_t i = (uint32_t)x;
+        if (i >= kSize) return t[kSize];
+        const float frac = x - (float)i;
+        return t[i] + (t[i + 1] - t[i]) * frac;
+    }
+
+    // Reference (exact) window value at phase 0..1.
+    static double evaluate(uint32_t shape, double phase) {
+        const double twoPi = 6.283185307179586;
+        const double x = phase < 0.0 ? 0.0 : (phase > 1.0 ? 1.0 : phase);
+
+        switch (shape)
+        {
+        case kWindowTukey:
+        {
+            // cosine tapers over the first/last 25%, flat top
+            const double taper = 0.25;
+            if (x < taper) return 0.5 - 0.5 * std::cos(twoPi * x / (2.0 * taper));
+            if (x > 1.0 - taper) return 0.5 - 0.5 * std::cos(twoPi * (1.0 - x) / (2.0 * taper));
+            return 1.0;
+        }
+        case kWindowGaussian:
+        {
+            // shifted/rescaled so the edges land exactly on zero
+            const double sigma = 0.15;
+            const double d = (x - 0.5) / sigma;
+            const double edge = std::exp(-0.5 * (0.5 / sigma) * (0.5 / sigma));
+            return (std::exp(-0.5 * d * d) - edge) / (1.0 - edge);
+        }
+        case kWindowTrapezoid:
+        {
+            const double ramp = 0.25;
+            if (x < ramp) return x / ramp;
+            if (x > 1.0 - ramp) return (1.0 - x) / ramp;
+            return 1.0;
+        }
+        case kWindowHann:
+        default:
+            return 0.5 - 0.5 * std::cos(twoPi * x);
+        }
+    }
+
+private:
+    float table[kWindowShapeCount][kSize + 1];
+};
+
+#endif // GRAIN_WINDOW_HPP_INCLUDED
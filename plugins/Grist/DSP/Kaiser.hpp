@@ -0,0 +1,55 @@
+/*
+ * Grist — Kaiser-windowed sinc
+ *
+ * The one FIR design used across Grist's offline filters: the load-time
+ * resampler, the mipmap half-band decimator and the polyphase sinc grain
+ * interpolators. Filter tables are built once, off the audio thread.
+ */
+
+#ifndef KAISER_HPP_INCLUDED
+#define KAISER_HPP_INCLUDED
+
+#include <cmath>
+
+// Zeroth-order modified Bessel function of the first kind (power series).
+static inline double besselI0(const double x)
+{
+    // converges quickly for the beta range used here
+    double sum = 1.0, term = 1.0;
+    const double q = x * x * 0.25;
+    for (int k = 1; k < 64; ++k)
+    {
+        term *= q / ((double)k * (double)k);
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+// Taps of a lowpass: sinc with `cutoff` relative to Nyquist (gain `cutoff`, so a full-length
+// filter has unity DC gain) under a Kaiser window `halfWidth` samples to either side.
+class KaiserSinc {
+public:
+    KaiserSinc(const double cutoff, const double halfWidth, const double beta)
+        : cutoff(cutoff), halfWidth(halfWidth), beta(beta), i0Beta(besselI0(beta)) {}
+
+    // Tap at `x` samples from the centre; zero outside the window.
+    double operator()(const double x) const
+    {
+        const double pi = 3.14159265358979323846;
+        const double r = x / halfWidth;
+        if (!(r > -1.0 && r < 1.0))
+            return 0.0;
+        const double sinc = (x == 0.0) ? 1.0 : std::sin(pi * cutoff * x) / (pi * cutoff * x);
+        return cutoff * sinc * besselI0(beta * std::sqrt(1.0 - r * r)) / i0Beta;
+    }
+
+private:
+    double cutoff;
+    double halfWidth;
+    double beta;
+    double i0Beta; // window normaliser, computed once
+};
+
+#endif // KAISER_HPP_INCLUDED
@@ -0,0 +1,114 @@
+/*
+ * Grist — Read-only file mapping
+ *
+ * Maps a whole file read-only so sample data can be used in place.
+ * Pages come from the OS page cache and are shared by every instance
+ * (and process) that maps the same file. POSIX only; open() fails
+ * elsewhere and callers fall back to decoding into memory.
+ */
+
+#ifndef MAPPED_FILE_HPP_INCLUDED
+#define MAPPED_FILE_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__unix__) || defined(__APPLE__)
+# define MAPPED_FILE_POSIX 1
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path)
+    {
+        close();
+#if defined(MAPPED_FILE_POSIX)
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size <= 0)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void* const p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (p == MAP_FAILED)
+            return false;
+
+        base = static_cast<const uint8_t*>(p);
+        length = (size_t)st.st_size;
+        return true;
+#else
+        (void)path;
+        return false;
+#endif
+    }
+
+    void close()
+    {
+#if defined(MAPPED_FILE_POSIX)
+        if (base != nullptr)
+            ::munmap(const_cast<uint8_t*>(base), length);
+#endif
+        base = nullptr;
+        length = 0;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+    const uint8_t* data() const { return base; }
+    size_t size() const { return length; }
+
+    // Asks the kernel to start reading [offset, offset + bytes) in the background.
+    // A syscall: call it from a non-realtime thread.
+    void prefetch(size_t offset, size_t bytes) const
+    {
+        advise(offset, bytes, kWillNeed);
+    }
+
+    // Hints that access is scattered, so the kernel skips large sequential read-ahead.
+    void adviseRandom() const
+    {
+        advise(0, length, kRandom);
+    }
+
+private:
+    enum Advice { kWillNeed, kRandom };
+
+    void advise(size_t offset, size_t bytes, Advice advice) const
+    {
+#if defined(MAPPED_FILE_POSIX)
+        if (base == nullptr || offset >= length)
+            return;
+        if (bytes > length - offset)
+            bytes = length - offset;
+
+        // madvise wants a page-aligned start
+        const size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+        const size_t start = offset - offset % page;
+        ::madvise(const_cast<uint8_t*>(base) + start, bytes + (offset - start),
+                  advice == kWillNeed ? MADV_WILLNEED : MADV_RANDOM);
+#else
+        (void)offset; (void)bytes; (void)advice;
+#endif
+    }
+
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+};
+
+#endif // MAPPED_FILE_HPP_INCLUDED
@@ -0,0 +1,98 @@
+/*
+ * Grist — Resident sample memory
+ *
+ * Grain reads must never take a page fault on the audio thread. The loader
+ * touches every page of the sample memory (prefault), then mlock()s it so
+ * it stays resident under memory pressure. A MemoryLock remembers what it
+ * locked and unlocks it on destruction, so declare it after the memory it
+ * covers (members are destroyed in reverse order). Non-RT threads only;
+ * POSIX only (elsewhere memory is prefaulted but not locked).
+ */
+
+#ifndef MEMORY_LOCK_HPP_INCLUDED
+#define MEMORY_LOCK_HPP_INCLUDED
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+# define MEMORY_LOCK_POSIX 1
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+class MemoryLock {
+public:
+    MemoryLock() = default;
+    ~MemoryLock() { unlockAll(); }
+
+    MemoryLock(const MemoryLock&) = delete;
+    MemoryLock& operator=(const MemoryLock&) = delete;
+
+    // Prefaults and locks the first min(bytes, budget) bytes at p. Returns the bytes locked;
+    // a failed mlock leaves them prefaulted only and sets `error` (errno) if not already set.
+    size_t lock(const void* p, size_t bytes, size_t budget, int& error)
+    {
+        bytes = std::min(bytes, budget);
+        if (p == nullptr || bytes == 0)
+            return 0;
+
+        const size_t page = pageSize();
+        const uintptr_t begin = (uintptr_t)p & ~(uintptr_t)(page - 1);
+        const uintptr_t end = (uintptr_t)p + bytes;
+
+        // one read per page faults it in (works for read-only mappings too)
+        for (uintptr_t a = begin; a < end; a += page)
+            (void)*reinterpret_cast<const volatile uint8_t*>(std::max(a, (uintptr_t)p));
+
+#if defined(MEMORY_LOCK_POSIX)
+        if (::mlock(reinterpret_cast<const void*>(begin), (size_t)(end - begin)) != 0)
+        {
+            if (error == 0)
+                error = errno;
+            return 0;
+        }
+        ranges.push_back({ begin, (size_t)(end - begin) });
+        total += bytes;
+        return bytes;
+#else
+        if (error == 0)
+            error = ENOSYS;
+        return 0;
+#endif
+    }
+
+    size_t lockedBytes() const { return total; }
+
+    void unlockAll()
+    {
+#if defined(MEMORY_LOCK_POSIX)
+        for (const Range& r : ranges)
+            ::munlock(reinterpret_cast<const void*>(r.begin), r.bytes);
+#endif
+        ranges.clear();
+        total = 0;
+    }
+
+private:
+    static size_t pageSize()
+    {
+#if defined(MEMORY_LOCK_POSIX)
+        return (size_t)::sysconf(_SC_PAGESIZE);
+#else
+        return 4096;
+#endif
+    }
+
+    struct Range {
+        uintptr_t begin;
+        size_t bytes;
+    };
+    std::vector<Range> ranges;
+    size_t total = 0;
+};
+
+#endif // MEMORY_LOCK_HPP_INCLUDED
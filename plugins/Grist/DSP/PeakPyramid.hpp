@@ -0,0 +1,128 @@
+/*
+ * Grist — Multi-resolution waveform peaks
+ *
+ * Min/max of the (mono-mixed) source over bins of kBaseFrames frames,
+ * plus coarser levels that each merge pairs of bins of the level below,
+ * up to a single bin. Built once by the loader thread with a sequential
+ * pass; immutable afterwards, so the UI reads it without locking.
+ *
+ * Any frame range is answered like a segment-tree query: whole bins of the
+ * coarsest levels that fit inside it plus finer bins at its edges, so
+ * every zoom level is served directly without rescanning the source.
+ */
+
+#ifndef PEAK_PYRAMID_HPP_INCLUDED
+#define PEAK_PYRAMID_HPP_INCLUDED
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class PeakPyramid {
+public:
+    static constexpr uint32_t kBaseShift = 6;
+    static constexpr uint32_t kBaseFrames = 1u << kBaseShift;
+
+    struct Peak {
+        float lo;
+        float hi;
+    };
+
+    explicit PeakPyramid(uint64_t totalFrames)
+        : frames(totalFrames)
+    {
+        levels.emplace_back();
+        levels[0].reserve((size_t)((frames + kBaseFrames - 1) >> kBaseShift));
+    }
+
+    // Loader: appends the next n frames of the mono mix.
+    void add(const float* mono, size_t n)
+    {
+        std::vector<Peak>& base = levels[0];
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (fill == 0)
+                base.push_back({ mono[i], mono[i] });
+            else
+            {
+                Peak& p = base.back();
+                p.lo = std::min(p.lo, mono[i]);
+                p.hi = std::max(p.hi, mono[i]);
+            }
+            fill = (fill + 1) & (kBaseFrames - 1);
+        }
+    }
+
+    // Loader: builds the coarser levels once every frame has been added.
+    void finish()
+    {
+        while (levels.back().size() > 1)
+        {
+            const std::vector<Peak>& fine = levels.back();
+            std::vector<Peak> coarse((fine.size() + 1) / 2);
+            for (size_t i = 0; i < coarse.size(); ++i)
+            {
+                const Peak& a = fine[i * 2];
+                const Peak& b = (i * 2 + 1 < fine.size()) ? fine[i * 2 + 1] : a;
+                coarse[i] = { std::min(a.lo, b.lo), std::max(a.hi, b.hi) };
+            }
+            levels.push_back(std::move(coarse));
+        }
+    }
+
+    uint64_t frameCount() const { return frames; }
+    uint32_t levelCount() const { return (uint32_t)levels.size(); }
+
+    // Min/max over frames [begin, end), rounded out to whole base bins. Walks up the
+    // levels taking the odd bins at each edge: O(log n) bins for any range.
+    Peak range(uint64_t begin, uint64_t end) const
+    {
+        const std::vector<Peak>& base = levels[0];
+        if (base.empty())
+            return { 0.0f, 0.0f };
+        if (end <= begin)
+            end = begin + 1;
+
+        size_t b0 = std::min<size_t>((size_t)(begin >> kBaseShift), base.size() - 1);
+        size_t b1 = std::min<size_t>((size_t)((end - 1) >> kBaseShift), base.size() - 1) + 1;
+
+        Peak r = base[b0];
+        for (uint32_t level = 0; b0 < b1; ++level, b0 >>= 1, b1 >>= 1)
+        {
+            const std::vector<Peak>& bins = levels[level];
+            if (b0 & 1)
+                merge(r, bins[b0++]);
+            if (b1 & 1)
+                merge(r, bins[--b1]);
+        }
+        return r;
+    }
+
+    // Splits frames [begin, end) into `cols` columns (a zoomed view when not the whole file).
+    void columns(uint64_t begin, uint64_t end, uint32_t cols, float* lo, float* hi) const
+    {
+        const double span = (double)(end - begin) / (double)cols;
+        for (uint32_t c = 0; c < cols; ++c)
+        {
+            const uint64_t b = begin + (uint64_t)(span * c);
+            const uint64_t e = std::max<uint64_t>(b + 1, begin + (uint64_t)(span * (c + 1)));
+            const Peak p = range(b, e);
+            lo[c] = p.lo;
+            hi[c] = p.hi;
+        }
+    }
+
+private:
+    static void merge(Peak& r, const Peak& p)
+    {
+        r.lo = std::min(r.lo, p.lo);
+        r.hi = std::max(r.hi, p.hi);
+    }
+
+    uint64_t frames;
+    uint32_t fill = 0; // frames in the last base bin (mod kBaseFrames)
+    std::vector<std::vector<Peak>> levels;
+};
+
+#endif // PEAK_PYRAMID_HPP_INCLUDED
@@ -0,0 +1,108 @@
+/*
+ * Grist — Polyphase windowed-sinc resampler
+ *
+ * Offline sample-rate conversion, used at load time to bring sources to the
+ * host rate. Kaiser-windowed sinc stored as a table of kPhases sub-sample
+ * phases (plus a guard phase); each output frame interpolates linearly
+ * between the two nearest phases and takes one dot product over the taps.
+ * Downsampling widens the kernel so the cutoff follows the output Nyquist.
+ */
+
+#ifndef RESAMPLER_HPP_INCLUDED
+#define RESAMPLER_HPP_INCLUDED
+
+#include "Kaiser.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class PolyphaseResampler {
+public:
+    static constexpr uint32_t kPhases = 512;
+    static constexpr uint32_t kZeroCrossings = 16; // per side, at the output rate
+
+    PolyphaseResampler(double inRate, double outRate)
+        : step(inRate / outRate)
+    {
+        // cutoff relative to the input Nyquist, with a small transition band
+        const double cutoff = 0.97 * (outRate < inRate ? outRate / inRate : 1.0);
+
+        half = (uint32_t)std::ceil(kZeroCrossings / cutoff);
+        taps = 2 * half;
+        taps = (taps + 7u) & ~7u; // whole vectors
+        half = taps / 2;
+
+        const KaiserSinc kernel(cutoff, (double)half, 8.0);
+
+        table.resize((size_t)(kPhases + 1) * taps);
+        for (uint32_t p = 0; p <= kPhases; ++p)
+        {
+            const double frac = (double)p / (double)kPhases;
+            float* const c = &table[(size_t)p * taps];
+            double sum = 0.0;
+            for (uint32_t k = 0; k < taps; ++k)
+            {
+                // distance (input samples) from the output position to tap k
+                const double h = kernel((double)k - (double)(half - 1) - frac);
+                c[k] = (float)h;
+                sum += h;
+            }
+            // unity DC gain for every phase
+            if (sum != 0.0)
+                for (uint32_t k = 0; k < taps; ++k)
+                    c[k] = (float)(c[k] / sum);
+        }
+    }
+
+    // Frames produced from `inFrames` input frames.
+    size_t outputLength(size_t inFrames) const
+    {
+        return inFrames == 0 ? 0 : (size_t)std::floor((double)(inFrames - 1) / step) + 1;
+    }
+
+    // Renders output frames [outBegin, outEnd) of a single channel with random access
+    // into the whole input (positions outside it read as silence).
+    void process(const float* in, size_t inFrames, float* out, size_t outBegin, size_t outEnd) const
+    {
+        for (size_t j = outBegin; j < outEnd; ++j)
+        {
+            const double t = (double)j * step;
+            const size_t idx = (size_t)t;
+            const double pos = (t - (double)idx) * (double)kPhases;
+            const uint32_t p = (uint32_t)pos;
+            const float pf = (float)(pos - (double)p);
+
+            const float* const c0 = &table[(size_t)p * taps];
+            const float* const c1 = c0 + taps;
+            const ptrdiff_t base = (ptrdiff_t)idx - (ptrdiff_t)(half - 1);
+
+            float acc = 0.0f;
+            if (base >= 0 && (size_t)base + taps <= inFrames)
+            {
+                const float* const x = in + base;
+                for (uint32_t k = 0; k < taps; ++k)
+                    acc += x[k] * (c0[k] + (c1[k] - c0[k]) * pf);
+            }
+            else
+            {
+                for (uint32_t k = 0; k < taps; ++k)
+                {
+                    const ptrdiff_t i = base + (ptrdiff_t)k;
+                    if (i >= 0 && (size_t)i < inFrames)
+                        acc += in[i] * (c0[k] + (c1[k] - c0[k]) * pf);
+                }
+            }
+            out[j - outBegin] = acc;
+        }
+    }
+
+private:
+    double step;          // input frames per output frame
+    uint32_t half = 0;
+    uint32_t taps = 0;
+    std::vector<float> table; // (kPhases + 1) x taps
+};
+
+#endif // RESAMPLER_HPP_INCLUDED
@@ -0,0 +1,212 @@
+/*
+ * Grist — Onset / energy index
+ *
+ * Built by the loader thread in one sequential pass over the (mono-mixed)
+ * source, after the sample is already playing, and then handed to the
+ * audio thread read-only. Positions are normalised to 0..1 of the source
+ * length, the same space grain spawning draws positions in, so one index
+ * serves the sample at any rate.
+ *
+ * - Energy: mean square per block of kBlockFrames frames, with a running
+ *   sum so the loudness of any span is O(1).
+ * - Onsets: blocks whose energy jumps by kOnsetRatio over the recent
+ *   average (and clears the silence floor), at least kOnsetGapBlocks apart.
+ * - Audible runs: maximal stretches of blocks above the silence floor,
+ *   with a running total so a uniform draw over the audible part of any
+ *   window maps back to a position.
+ *
+ * Onset and audible queries are binary searches: O(log n) per grain spawn.
+ */
+
+#ifndef SAMPLE_ANALYSIS_HPP_INCLUDED
+#define SAMPLE_ANALYSIS_HPP_INCLUDED
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Where grains start within the position/spray window.
+enum GrainSpawnMode {
+    kSpawnFree = 0,  // uniformly anywhere in the window
+    kSpawnOnsets,    // at the onset nearest the drawn position
+    kSpawnAudible,   // uniformly over the audible part of the window; no grain if it is all silence
+    kSpawnModeCount
+};
+
+class SampleAnalysis {
+public:
+    static constexpr uint32_t kBlockFrames = 512;
+    static constexpr float kSilenceFloor = 1e-6f;  // mean square, -60 dBFS
+    static constexpr float kOnsetRatio = 4.0f;     // +6 dB over the recent average
+    static constexpr uint32_t kOnsetHistory = 4;   // blocks averaged for the onset reference
+    static constexpr uint32_t kOnsetGapBlocks = 4; // minimum onset spacing
+
+    explicit SampleAnalysis(uint64_t totalFrames)
+        : frames(totalFrames)
+    {
+        energy.reserve((size_t)((frames + kBlockFrames - 1) / kBlockFrames));
+    }
+
+    // Loader: appends the next n frames of the mono mix.
+    void add(const float* mono, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            sum += (double)mono[i] * (double)mono[i];
+            if (++fill == kBlockFrames)
+                closeBlock();
+        }
+    }
+
+    // Loader: finishes the last partial block and builds the onset and audible-run tables.
+    void finish()
+    {
+        if (fill != 0)
+            closeBlock();
+
+        const double norm = 1.0 / (double)std::max<uint64_t>(frames, 1);
+        const size_t blocks = energy.size();
+
+        energyCum.resize(blocks + 1);
+        energyCum[0] = 0.0;
+        for (size_t b = 0; b < blocks; ++b)
+            energyCum[b + 1] = energyCum[b] + (double)energy[b];
+
+        size_t lastOnset = 0;
+        bool haveOnset = false;
+        for (size_t b = 0; b < blocks; ++b)
+        {
+            float ref = 0.0f;
+            const size_t h = std::min<size_t>(b, kOnsetHistory);
+            for (size_t k = 1; k <= h; ++k)
+                ref += energy[b - k];
+            ref = (h > 0) ? ref / (float)h : 0.0f;
+
+            if (energy[b] > kSilenceFloor && energy[b] > kOnsetRatio * std::max(ref, kSilenceFloor)
+                && (!haveOnset || b - lastOnset >= kOnsetGapBlocks))
+            {
+                onsets.push_back((double)(b * kBlockFrames) * norm);
+                lastOnset = b;
+                haveOnset = true;
+            }
+        }
+
+        double cum = 0.0;
+        for (size_t b = 0; b < blocks;)
+        {
+            if (energy[b] <= kSilenceFloor)
+            {
+                ++b;
+                continue;
+            }
+            const size_t first = b;
+            while (b < blocks && energy[b] > kSilenceFloor)
+                ++b;
+
+            const double start = (double)(first * kBlockFrames) * norm;
+            const double end = std::min(1.0, (double)(b * kBlockFrames) * norm);
+            runStart.push_back(start);
+            runEnd.push_back(end);
+            runCum.push_back(cum);
+            cum += end - start;
+        }
+    }
+
+    size_t onsetCount() const { return onsets.size(); }
+    uint32_t blockCount() const { return (uint32_t)energy.size(); }
+
+    // Audio thread: the onset nearest to `pos`; false when the source has none.
+    bool nearestOnset(double pos, double& out) const
+    {
+        if (onsets.empty())
+            return false;
+        const size_t j = (size_t)(std::lower_bound(onsets.begin(), onsets.end(), pos) - onsets.begin());
+        if (j == onsets.size())
+            out = onsets[j - 1];
+        else if (j == 0)
+            out = onsets[0];
+        else
+            out = (pos - onsets[j - 1] <= onsets[j] - pos) ? onsets[j - 1] : onsets[j];
+        return true;
+    }
+
+    // Audio thread: mean square of the mono mix over normalised [a, b], whole blocks.
+    float meanSquare(double a, double b) const
+    {
+        const size_t blocks = energy.size();
+        if (blocks == 0)
+            return 0.0f;
+
+        const double scale = (double)frames / (double)kBlockFrames;
+        const size_t b0 = std::min(blocks - 1, (size_t)std::max(0.0, a * scale));
+        const size_t b1 = std::min(blocks, std::max(b0 + 1, (size_t)std::max(0.0, std::ceil(b * scale))));
+        return (float)((energyCum[b1] - energyCum[b0]) / (double)(b1 - b0));
+    }
+
+    // Audio thread: maps u in [0, 1) uniformly onto the audible part of [lo, hi];
+    // false when that window is entirely silent.
+    bool pickAudible(double lo, double hi, double u, double& out) const
+    {
+        if (runStart.empty())
+            return false;
+
+        const double a = audibleBefore(lo);
+        const double total = audibleBefore(hi) - a;
+        if (total <= 0.0)
+        {
+            // zero-width window (no spray): fine as long as it sits in an audible run
+            const size_t i = runAt(lo);
+            if (hi <= lo && i < runStart.size() && lo >= runStart[i] && lo < runEnd[i])
+            {
+                out = lo;
+                return true;
+            }
+            return false;
+        }
+
+        const double target = a + u * total;
+        size_t i = (size_t)(std::upper_bound(runCum.begin(), runCum.end(), target) - runCum.begin());
+        i = (i > 0) ? i - 1 : 0;
+        out = std::min(runEnd[i], runStart[i] + (target - runCum[i]));
+        return true;
+    }
+
+private:
+    void closeBlock()
+    {
+        energy.push_back((float)(sum / (double)fill));
+        sum = 0.0;
+        fill = 0;
+    }
+
+    // Index of the last run starting at or before x (runStart.size() when none).
+    size_t runAt(double x) const
+    {
+        const size_t i = (size_t)(std::upper_bound(runStart.begin(), runStart.end(), x) - runStart.begin());
+        return i > 0 ? i - 1 : runStart.size();
+    }
+
+    // Audible length in [0, x).
+    double audibleBefore(double x) const
+    {
+        const size_t i = runAt(x);
+        if (i == runStart.size())
+            return 0.0;
+        return runCum[i] + std::min(x, runEnd[i]) - runStart[i];
+    }
+
+    uint64_t frames;
+    double sum = 0.0;
+    uint32_t fill = 0;
+
+    std::vector<float> energy;   // mean square per block
+    std::vector<double> energyCum; // energy summed over blocks [0, b)
+    std::vector<double> onsets;  // normalised, ascending
+    std::vector<double> runStart; // audible runs, normalised, ascending
+    std::vector<double> runEnd;
+    std::vector<double> runCum;   // audible length before each run
+};
+
+#endif // SAMPLE_ANALYSIS_HPP_INCLUDED
@@ -0,0 +1,97 @@
+/*
+ * Grist — Process-wide shared sample cache
+ *
+ * Instances that load the same file with the same options share one
+ * decoded copy. Entries are keyed by path plus the file's size and mtime
+ * (so an edited file is decoded again) plus the load options that shape
+ * the data. The cache only holds weak references: a sample is freed as
+ * soon as the last instance releases it, and its entry is pruned on the
+ * next lookup. Non-RT threads only.
+ */
+
+#ifndef SAMPLE_CACHE_HPP_INCLUDED
+#define SAMPLE_CACHE_HPP_INCLUDED
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+# include <sys/stat.h>
+#endif
+
+// Identity of `path` on disk plus the load options, or "" when the file cannot be stat'ed
+// (the caller then loads without the cache).
+static inline std::string sampleCacheKey(const char* path, uint32_t rate, uint32_t format, uint32_t mips)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct stat st;
+    if (path == nullptr || ::stat(path, &st) != 0)
+        return std::string();
+
+    char buf[96];
+    std::snprintf(buf, sizeof(buf), "|%llu|%lld|%u|%u|%u", (unsigned long long)st.st_size,
+                  (long long)st.st_mtime, rate, format, mips);
+    return std::string(path) + buf;
+#else
+    (void)path; (void)rate; (void)format; (void)mips;
+    return std::string();
+#endif
+}
+
+template <typename T>
+class SharedSampleCache {
+public:
+    static SharedSampleCache& instance()
+    {
+        static SharedSampleCache cache;
+        return cache;
+    }
+
+    std::shared_ptr<const T> find(const std::string& key)
+    {
+        if (key.empty())
+            return nullptr;
+
+        const std::lock_guard<std::mutex> lock(mutex);
+        prune();
+        const auto it = entries.find(key);
+        return it != entries.end() ? it->second.lock() : nullptr;
+    }
+
+    // Registers a freshly loaded sample. A live entry for the same key is kept
+    // (two instances raced to load the same file; later lookups get the first).
+    void insert(const std::string& key, const std::shared_ptr<const T>& data)
+    {
+        if (key.empty() || !data)
+            return;
+
+        const std::lock_guard<std::mutex> lock(mutex);
+        prune();
+        std::weak_ptr<const T>& entry = entries[key];
+        if (entry.expired())
+            entry = data;
+    }
+
+private:
+    SharedSampleCache() = default;
+
+    void prune()
+    {
+        for (auto it = entries.begin(); it != entries.end();)
+        {
+            if (it->second.expired())
+                it = entries.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    std::mutex mutex;
+    std::map<std::string, std::weak_ptr<const T>> entries;
+};
+
+#endif // SAMPLE_CACHE_HPP_INCLUDED
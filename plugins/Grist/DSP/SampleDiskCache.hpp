@@ -0,0 +1,178 @@
+/*
+ * Grist — Persistent decoded-sample cache
+ *
+ * Decoded (and resampled / packed) samples can be written to
+ * $XDG_CACHE_HOME/grist (~/.cache/grist by default) so a later session
+ * maps the finished data with a single mmap instead of parsing and
+ * converting the WAV again.
+ *
+ * One file per entry, named by a hash of the cache key (source path, size,
+ * mtime and load options). Layout: a fixed header, the full key (checked
+ * on open, so hash collisions and stale files are rejected), then planar
+ * channel data starting at a page-aligned offset, then the mip levels. Native byte order; files
+ * from another architecture fail the check and are rewritten.
+ *
+ * Entries are written to a temporary name and renamed into place, so a
+ * reader never sees a partial file. Non-RT threads only; POSIX only.
+ */
+
+#ifndef SAMPLE_DISK_CACHE_HPP_INCLUDED
+#define SAMPLE_DISK_CACHE_HPP_INCLUDED
+
+#include "MappedFile.hpp"
+#include "SampleFormat.hpp"
+#include "SampleMips.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(MAPPED_FILE_POSIX)
+# include <unistd.h>
+#endif
+
+struct SampleDiskCacheHeader {
+    static constexpr uint32_t kVersion = 2;
+    static constexpr uint32_t kByteOrder = 0x01020304u;
+    static constexpr uint64_t kDataAlign = 4096;
+
+    char magic[8];        // "GRISTSMP"
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t channels;
+    uint32_t sampleRate;
+    uint32_t format;      // SampleFormat
+    uint32_t keyBytes;    // key follows the header
+    uint32_t mipCount;    // mip levels stored after level 0
+    uint32_t reserved;
+    uint64_t frames;
+    uint64_t dataOffset;  // channel 0; channel 1 follows at dataOffset + frames * sampleFormatBytes,
+                          // then the mip block (see mipBlockElements)
+};
+
+// Where a key's entry lives, or "" when no cache directory can be determined.
+static inline std::string sampleDiskCachePath(const std::string& key)
+{
+    if (key.empty())
+        return std::string();
+
+    std::string dir;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"))
+        dir = xdg;
+    if (dir.empty())
+    {
+        const char* const home = std::getenv("HOME");
+        if (home == nullptr || home[0] == '\0')
+            return std::string();
+        dir = std::string(home) + "/.cache";
+    }
+
+    // FNV-1a
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (const char c : key)
+        h = (h ^ (uint8_t)c) * 0x100000001B3ull;
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016llx.gsmp", (unsigned long long)h);
+    return dir + "/grist" + name;
+}
+
+// Maps the entry for `key` into `map`. On success `hdr` describes it and channel data
+// starts at map.data() + hdr.dataOffset.
+static inline bool openSampleDiskCache(const std::string& key, MappedFile& map, SampleDiskCacheHeader& hdr)
+{
+    const std::string path = sampleDiskCachePath(key);
+    if (path.empty() || !map.open(path.c_str()))
+        return false;
+
+    if (map.size() < sizeof(hdr))
+        return false;
+    std::memcpy(&hdr, map.data(), sizeof(hdr));
+
+    if (std::memcmp(hdr.magic, "GRISTSMP", 8) != 0
+        || hdr.version != SampleDiskCacheHeader::kVersion
+        || hdr.byteOrder != SampleDiskCacheHeader::kByteOrder
+        || (hdr.channels != 1 && hdr.channels != 2)
+        || hdr.format >= kSampleFormatCount
+        || hdr.frames < 2 || hdr.mipCount > mipLevelCount((size_t)hdr.frames))
+        return false;
+
+    const uint64_t elements = hdr.frames * hdr.channels + mipBlockElements((size_t)hdr.frames, hdr.channels, hdr.mipCount);
+    const uint64_t bytes = elements * sampleFormatBytes((SampleFormat)hdr.format);
+    return hdr.keyBytes == key.size()
+        && sizeof(hdr) + key.size() <= map.size()
+        && std::memcmp(map.data() + sizeof(hdr), key.data(), key.size()) == 0
+        && hdr.dataOffset % SampleDiskCacheHeader::kDataAlign == 0
+        && hdr.dataOffset <= map.size() && bytes <= map.size() - hdr.dataOffset;
+}
+
+// Writes an entry for `key`; channel data is `frames` elements of `format` per channel,
+// `mips` the block of mipCount levels above it.
+static inline bool writeSampleDiskCache(const std::string& key, uint32_t channels, uint32_t sampleRate,
+                                        SampleFormat format, uint64_t frames, const void* L, const void* R,
+                                        const void* mips, uint32_t mipCount)
+{
+#if defined(MAPPED_FILE_POSIX)
+    const std::string path = sampleDiskCachePath(key);
+    if (path.empty())
+        return false;
+
+    // create the directory chain (the cache root may not exist yet)
+    for (size_t i = 1; i != std::string::npos; i = path.find('/', i + 1))
+        ::mkdir(path.substr(0, i).c_str(), 0755);
+
+    SampleDiskCacheHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, "GRISTSMP", 8);
+    hdr.version = SampleDiskCacheHeader::kVersion;
+    hdr.byteOrder = SampleDiskCacheHeader::kByteOrder;
+    hdr.channels = channels;
+    hdr.sampleRate = sampleRate;
+    hdr.format = format;
+    hdr.keyBytes = (uint32_t)key.size();
+    hdr.mipCount = mipCount;
+    hdr.frames = frames;
+    const uint64_t align = SampleDiskCacheHeader::kDataAlign;
+    hdr.dataOffset = (sizeof(hdr) + key.size() + align - 1) / align * align;
+
+    // unique per writer: instances in other processes, or in this one, may race on the same key
+    static std::atomic<uint32_t> writerSerial {0};
+    char tmpSuffix[48];
+    std::snprintf(tmpSuffix, sizeof(tmpSuffix), ".tmp%ld.%u", (long)::getpid(), writerSerial.fetch_add(1));
+    const std::string tmp = path + tmpSuffix;
+
+    FILE* const f = std::fopen(tmp.c_str(), "wb");
+    if (f == nullptr)
+        return false;
+
+    const size_t channelBytes = (size_t)frames * sampleFormatBytes(format);
+    const size_t pad = (size_t)hdr.dataOffset - sizeof(hdr) - key.size();
+    static const char zeros[SampleDiskCacheHeader::kDataAlign] = {};
+
+    bool ok = std::fwrite(&hdr, sizeof(hdr), 1, f) == 1
+           && std::fwrite(key.data(), 1, key.size(), f) == key.size()
+           && std::fwrite(zeros, 1, pad, f) == pad
+           && std::fwrite(L, 1, channelBytes, f) == channelBytes;
+    if (ok && channels == 2)
+        ok = std::fwrite(R, 1, channelBytes, f) == channelBytes;
+    const size_t mipBytes = mipBlockElements((size_t)frames, channels, mipCount) * sampleFormatBytes(format);
+    if (ok && mipBytes != 0)
+        ok = std::fwrite(mips, 1, mipBytes, f) == mipBytes;
+    ok = (std::fclose(f) == 0) && ok;
+
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+#else
+    (void)key; (void)channels; (void)sampleRate; (void)format; (void)frames; (void)L; (void)R; (void)mips; (void)mipCount;
+    return false;
+#endif
+}
+
+#endif // SAMPLE_DISK_CACHE_HPP_INCLUDED
@@ -0,0 +1,136 @@
+/*
+ * Grist — In-memory sample formats
+ *
+ * Decoded samples can be kept as 32-bit float, or packed to 16 bits per
+ * sample (int16 or IEEE half) to halve resident memory and the bandwidth
+ * of grain reads. Packing happens once on the loader thread; the grain
+ * kernels decode each tap through SampleCodec as they gather it.
+ *
+ * int16 is a fixed-point format: exact for 16-bit sources, -96 dBFS floor.
+ * half keeps 11 bits of mantissa at every level (about -66 dB relative),
+ * so quiet material loses less than with int16.
+ */
+
+#ifndef SAMPLE_FORMAT_HPP_INCLUDED
+#define SAMPLE_FORMAT_HPP_INCLUDED
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+enum SampleFormat : uint32_t {
+    kSampleFloat32 = 0,
+    kSampleInt16,
+    kSampleHalf,
+    kSampleFormatCount
+};
+
+static inline size_t sampleFormatBytes(SampleFormat f)
+{
+    return f == kSampleFloat32 ? 4 : 2;
+}
+
+static inline const char* sampleFormatName(SampleFormat f)
+{
+    return f == kSampleInt16 ? "int16" : (f == kSampleHalf ? "half" : "float");
+}
+
+// Parses the "sample_format" state; unknown names mean float.
+static inline SampleFormat sampleFormatFromName(const char* name)
+{
+    if (name != nullptr && std::strcmp(name, "int16") == 0)
+        return kSampleInt16;
+    if (name != nullptr && std::strcmp(name, "half") == 0)
+        return kSampleHalf;
+    return kSampleFloat32;
+}
+
+static inline uint32_t floatBits(float f) { uint32_t u; std::memcpy(&u, &f, 4); return u; }
+static inline float bitsFloat(uint32_t u) { float f; std::memcpy(&f, &u, 4); return f; }
+
+// IEEE half -> float, exact for every input (denormals, inf, NaN).
+static inline float halfToFloat(uint16_t h)
+{
+    const uint32_t shiftedExp = 0x7C00u << 13;
+    uint32_t o = (uint32_t)(h & 0x7FFFu) << 13;
+    const uint32_t exp = o & shiftedExp;
+    o += (127u - 15u) << 23;
+    if (exp == shiftedExp)
+        o += (128u - 16u) << 23; // inf/NaN
+    else if (exp == 0)
+        o = floatBits(bitsFloat(o + (1u << 23)) - bitsFloat(113u << 23)); // denormal: renormalise
+    return bitsFloat(o | ((uint32_t)(h & 0x8000u) << 16));
+}
+
+// float -> IEEE half, round to nearest even; overflow goes to inf.
+static inline uint16_t floatToHalf(float f)
+{
+    uint32_t u = floatBits(f);
+    const uint32_t sign = u & 0x80000000u;
+    u ^= sign;
+
+    uint32_t o;
+    if (u >= (127u + 16u) << 23)
+        o = (u > 255u << 23) ? 0x7E00u : 0x7C00u;
+    else if (u < 113u << 23)
+    {
+        // denormal: let the FPU round by adding a magic number
+        const uint32_t magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+        o = floatBits(bitsFloat(u) + bitsFloat(magic)) - magic;
+    }
+    else
+    {
+        const uint32_t mantOdd = (u >> 13) & 1u;
+        u += ((uint32_t)(15 - 127) << 23) + 0xFFFu + mantOdd;
+        o = u >> 13;
+    }
+    return (uint16_t)(o | (sign >> 16));
+}
+
+static inline int16_t floatToInt16(float f)
+{
+    const float v = std::nearbyint(f * 32768.0f);
+    return (int16_t)(v > 32767.0f ? 32767.0f : (v < -32768.0f ? -32768.0f : v));
+}
+
+// Per-format tap decoding for the grain kernels. load() may return the stored value
+// in its own units; kScale brings it to float range and is folded into the grain gain.
+template <SampleFormat F> struct SampleCodec;
+
+template <> struct SampleCodec<kSampleFloat32> {
+    typedef float Storage;
+    static constexpr float kScale = 1.0f;
+    static inline float load(const Storage* p, size_t i) { return p[i]; }
+};
+
+template <> struct SampleCodec<kSampleInt16> {
+    typedef int16_t Storage;
+    static constexpr float kScale = 1.0f / 32768.0f;
+    static inline float load(const Storage* p, size_t i) { return (float)p[i]; }
+};
+
+template <> struct SampleCodec<kSampleHalf> {
+    typedef uint16_t Storage;
+    static constexpr float kScale = 1.0f;
+    static inline float load(const Storage* p, size_t i) { return halfToFloat(p[i]); }
+};
+
+// Packs n floats into a 16-bit format (dst holds n elements).
+static inline void packSamples(SampleFormat f, const float* src, size_t n, void* dst)
+{
+    if (f == kSampleInt16)
+    {
+        int16_t* const d = static_cast<int16_t*>(dst);
+        for (size_t i = 0; i < n; ++i)
+            d[i] = floatToInt16(src[i]);
+    }
+    else if (f == kSampleHalf)
+    {
+        uint16_t* const d = static_cast<uint16_t*>(dst);
+        for (size_t i = 0; i < n; ++i)
+            d[i] = floatToHalf(src[i]);
+    }
+}
+
+#endif // SAMPLE_FORMAT_HPP_INCLUDED
@@ -0,0 +1,109 @@
+/*
+ * Grist — Octave-decimated sample mipmaps
+ *
+ * Grains pitched up by an octave or more read a copy of the source at half
+ * (quarter, ...) the rate instead: band-limited, so the Catmull-Rom read
+ * no longer aliases, and smaller, so a fast grain touches fewer cache
+ * lines. Level k is level k - 1 run through a half-band lowpass and
+ * decimated by two; frame j of level k sits at frame j * 2^k of level 0.
+ *
+ * Levels are built once on the loader thread from the float source.
+ */
+
+#ifndef SAMPLE_MIPS_HPP_INCLUDED
+#define SAMPLE_MIPS_HPP_INCLUDED
+
+#include "GrainKernel.hpp"
+#include "Kaiser.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Frames of the level above one with `frames` frames.
+static inline size_t mipFrames(size_t frames)
+{
+    return (frames - 1) / 2 + 1;
+}
+
+// Mip levels (above level 0) worth building for a source of `frames` frames.
+static inline uint32_t mipLevelCount(size_t frames)
+{
+    uint32_t n = 0;
+    while (n + 1 < kGrainMipLevels && frames >= 256)
+    {
+        frames = mipFrames(frames);
+        ++n;
+    }
+    return n;
+}
+
+// Elements in a block holding mip levels 1..count of a source with `frames` frames:
+// level by level, each level's L then (stereo) R.
+static inline size_t mipBlockElements(size_t frames, uint32_t channels, uint32_t count)
+{
+    size_t total = 0;
+    for (uint32_t k = 0; k < count; ++k)
+    {
+        frames = mipFrames(frames);
+        total += frames * channels;
+    }
+    return total;
+}
+
+// Half-band FIR decimator (Kaiser-windowed sinc, cutoff at the output Nyquist).
+// Every other tap of a half-band filter is zero, so each output costs kSide
+// multiply-adds of symmetric pairs plus the centre tap.
+class HalfBandDecimator {
+public:
+    static constexpr int kSide = 12; // non-zero taps per side (odd offsets 1, 3, ..., 2*kSide - 1)
+
+    HalfBandDecimator()
+    {
+        const KaiserSinc kernel(0.5, (double)(2 * kSide), 7.0);
+        double coeff[kSide];
+        double sum = 0.5;
+        for (int i = 0; i < kSide; ++i)
+        {
+            const double h = kernel((double)(2 * i + 1));
+            coeff[i] = h;
+            sum += 2.0 * h;
+        }
+        // unity DC gain
+        centre = (float)(0.5 / sum);
+        for (int i = 0; i < kSide; ++i)
+            taps[i] = (float)(coeff[i] / sum);
+    }
+
+    // out[j] = filtered in[2j], j in [outBegin, outEnd); positions outside the input read as silence.
+    void process(const float* in, size_t inFrames, float* out, size_t outBegin, size_t outEnd) const
+    {
+        const size_t reach = 2 * kSide - 1;
+        for (size_t j = outBegin; j < outEnd; ++j)
+        {
+            const size_t c = 2 * j;
+            float acc = centre * in[c];
+            if (c >= reach && c + reach < inFrames)
+            {
+                for (int i = 0; i < kSide; ++i)
+                    acc += taps[i] * (in[c - (size_t)(2 * i + 1)] + in[c + (size_t)(2 * i + 1)]);
+            }
+            else
+            {
+                for (int i = 0; i < kSide; ++i)
+                {
+                    const size_t d = (size_t)(2 * i + 1);
+                    const float lo = (c >= d) ? in[c - d] : 0.0f;
+                    const float hi = (c + d < inFrames) ? in[c + d] : 0.0f;
+                    acc += taps[i] * (lo + hi);
+                }
+            }
+            out[j - outBegin] = acc;
+        }
+    }
+
+private:
+    float taps[kSide];
+    float centre;
+};
+
+#endif // SAMPLE_MIPS_HPP_INCLUDED
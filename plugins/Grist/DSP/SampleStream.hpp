@@ -0,0 +1,381 @@
+/*
+ * Grist — Disk-streamed sample source
+ *
+ * For sources too large to hold in RAM. The file is split into fixed-size
+ * pages; a reader thread decodes the pages around the current play window
+ * into a fixed pool of cache slots and publishes them in a page table.
+ * The audio thread only ever reads resident pages: a missing page renders
+ * silence and is counted as a miss.
+ *
+ * Each cached page stores the widest interpolation reach before and after
+ * its own range (7 and 8 frames, for 16-tap sinc), so a grain read never
+ * straddles two pages.
+ *
+ * Instances playing the same file share one stream. Each attaches a Reader:
+ * its audio thread's read epoch plus the window its stream thread keeps
+ * resident. service() calls are serialised, and a page inside any attached
+ * window is never evicted, so the windows must fit the cache together.
+ *
+ * Eviction: the reader unpublishes a page, then waits until every attached
+ * audio thread is outside run() (beginRead/endRead epoch) before reusing
+ * its slot.
+ */
+
+#ifndef SAMPLE_STREAM_HPP_INCLUDED
+#define SAMPLE_STREAM_HPP_INCLUDED
+
+#include "GrainKernel.hpp"
+#include "dr_wav.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class SampleStream {
+public:
+    static constexpr uint32_t kPageShift = 16;
+    static constexpr uint32_t kPageFrames = 1u << kPageShift;
+    static constexpr uint32_t kGuardBefore = kGrainInterpMaxBefore;
+    static constexpr uint32_t kGuardAfter = kGrainInterpMaxAfter;
+    static constexpr uint32_t kPagePitch = kGuardBefore + kPageFrames + kGuardAfter; // floats per channel
+
+    // One per instance: attached to every stream the instance may read (attach/detach on
+    // non-RT threads), bracketing its audio thread's reads of all of them.
+    class Reader {
+    public:
+        void beginRead() const
+        {
+            epoch.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        void endRead() const { epoch.fetch_add(1, std::memory_order_release); }
+
+    private:
+        friend class SampleStream;
+        mutable std::atomic<uint32_t> epoch {0}; // odd while the audio thread is reading
+    };
+
+    // Opens its own decoder on `path`. Check isOpen() afterwards.
+    SampleStream(const char* path, size_t cacheBytes)
+    {
+        if (!drwav_init_file(&wav, path, nullptr))
+            return;
+        if (wav.channels < 1 || wav.channels > 2 || wav.totalPCMFrameCount < 2)
+        {
+            drwav_uninit(&wav);
+            return;
+        }
+
+        frames = wav.totalPCMFrameCount;
+        channels = wav.channels;
+        numPages = (size_t)((frames + kPageFrames - 1) >> kPageShift);
+
+        // never fewer than a couple of slots, never more than the file needs
+        const size_t slotFloats = (size_t)kPagePitch * channels;
+        numSlots = cacheBytes / (slotFloats * sizeof(float));
+        if (numSlots < 2) numSlots = 2;
+        if (numSlots > numPages) numSlots = numPages;
+
+        table.reset(new std::atomic<const float*>[numPages]);
+        for (size_t p = 0; p < numPages; ++p)
+            table[p].store(nullptr, std::memory_order_relaxed);
+
+        slotData.resize(numSlots * slotFloats);
+        slotPage.assign(numSlots, (uint64_t)kNoPage);
+        scratch.resize((size_t)kPagePitch * channels);
+        open = true;
+    }
+
+    ~SampleStream()
+    {
+        if (open)
+            drwav_uninit(&wav);
+    }
+
+    SampleStream(const SampleStream&) = delete;
+    SampleStream& operator=(const SampleStream&) = delete;
+
+    bool isOpen() const { return open; }
+    uint64_t frameCount() const { return frames; }
+    uint32_t channelCount() const { return channels; }
+    uint32_t sampleRate() const { return wav.sampleRate; }
+    size_t cacheBytes() const { return slotData.size() * sizeof(float); }
+    const float* cacheData() const { return slotData.data(); }
+
+    // --- non-RT threads ---
+
+    // An attached reader's audio thread may read pages (inside Reader::beginRead/endRead).
+    // Attachments are counted: detach as often as attach.
+    void attach(const Reader& r)
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        for (Attachment& at : readers)
+            if (at.reader == &r)
+            {
+                ++at.refs;
+                return;
+            }
+        readers.push_back({ &r, 1, 1, 0 });
+    }
+
+    void detach(const Reader& r)
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < readers.size(); ++i)
+            if (readers[i].reader == &r && --readers[i].refs == 0)
+            {
+                readers.erase(readers.begin() + (std::ptrdiff_t)i);
+                return;
+            }
+    }
+
+    // --- audio thread ---
+
+    // Frame 0 of the page is at [kGuardBefore]; for stereo R follows L by kPagePitch floats. nullptr: not resident.
+    const float* page(uint64_t p) const { return table[p].load(std::memory_order_acquire); }
+    size_t rightOffset() const { return channels == 2 ? kPagePitch : 0; }
+
+    void addMisses(uint64_t n) const { misses.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t missCount() const { return misses.load(std::memory_order_relaxed); }
+
+    // --- reader thread ---
+
+    // Makes pages covering `r`'s window [beginFrame, endFrame) resident, nearest the middle first.
+    // Loads at most kMaxPagesPerService pages so new windows are picked up quickly.
+    void service(const Reader& r, uint64_t beginFrame, uint64_t endFrame)
+    {
+        if (!open)
+            return;
+        if (endFrame > frames) endFrame = frames;
+        if (beginFrame >= endFrame)
+            return;
+
+        uint64_t first = beginFrame >> kPageShift;
+        uint64_t last = (endFrame - 1) >> kPageShift;
+        if (last - first + 1 > numSlots)
+        {
+            // window larger than the cache: keep the part around its middle
+            const uint64_t mid = first + (last - first) / 2;
+            first = mid - numSlots / 2;
+            last = first + numSlots - 1;
+        }
+
+        const std::lock_guard<std::mutex> lock(mutex);
+        Attachment* self = nullptr;
+        for (Attachment& at : readers)
+            if (at.reader == &r)
+                self = &at;
+        if (self == nullptr)
+            return;
+        self->first = first;
+        self->last = last;
+
+        const uint64_t mid = first + (last - first) / 2;
+        uint32_t loaded = 0;
+        for (uint64_t d = 0; loaded < kMaxPagesPerService; ++d)
+        {
+            const bool upIn = mid + d <= last;
+            const bool downIn = d > 0 && mid >= first + d;
+            if (!upIn && !downIn)
+                break;
+            if (upIn && !ensureResident(mid + d, loaded))
+                return;
+            if (downIn && loaded < kMaxPagesPerService && !ensureResident(mid - d, loaded))
+                return;
+        }
+    }
+
+private:
+    static constexpr uint64_t kNoPage = ~(uint64_t)0;
+    static constexpr uint32_t kMaxPagesPerService = 8;
+
+    // One attached reader and the pages of its last serviced window (first > last: none yet).
+    struct Attachment {
+        const Reader* reader;
+        uint32_t refs;
+        uint64_t first, last;
+    };
+
+    bool ensureResident(uint64_t p, uint32_t& loaded)
+    {
+        if (table[p].load(std::memory_order_relaxed) != nullptr)
+            return true;
+
+        const size_t slot = takeSlot();
+        if (slot == numSlots)
+            return false;
+
+        float* const dst = slotData.data() + slot * (size_t)kPagePitch * channels;
+        fillPage(p, dst);
+        slotPage[slot] = p;
+        table[p].store(dst, std::memory_order_release);
+        ++loaded;
+        return true;
+    }
+
+    bool inAnyWindow(uint64_t p) const
+    {
+        for (const Attachment& at : readers)
+            if (p >= at.first && p <= at.last)
+                return true;
+        return false;
+    }
+
+    // A free slot, or one holding a page outside every reader's window. numSlots if none.
+    size_t takeSlot()
+    {
+        for (size_t s = 0; s < numSlots; ++s)
+            if (slotPage[s] == kNoPage)
+                return s;
+
+        for (size_t s = 0; s < numSlots; ++s)
+        {
+            const uint64_t p = slotPage[s];
+            if (inAnyWindow(p))
+                continue;
+
+            table[p].store(nullptr, std::memory_order_seq_cst);
+            slotPage[s] = kNoPage;
+            waitForAudio();
+            return s;
+        }
+        return numSlots;
+    }
+
+    // Returns once any run() that might still hold an unpublished page pointer has finished.
+    void waitForAudio() const
+    {
+        for (const Attachment& at : readers)
+        {
+            const uint32_t e = at.reader->epoch.load(std::memory_order_seq_cst);
+            if ((e & 1u) == 0)
+                continue;
+            while (at.reader->epoch.load(std::memory_order_acquire) == e)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // Decodes page p plus its guard frames into planar L/R; the file edges repeat the edge frame.
+    void fillPage(uint64_t p, float* dst)
+    {
+        const int64_t start = (int64_t)(p << kPageShift) - (int64_t)kGuardBefore;
+        const uint64_t readFirst = start < 0 ? 0 : (uint64_t)start;
+        const uint64_t readEnd = std::min<uint64_t>(frames, (uint64_t)(start + kPagePitch));
+
+        uint64_t got = 0;
+        if (drwav_seek_to_pcm_frame(&wav, readFirst))
+            got = drwav_read_pcm_frames_f32(&wav, readEnd - readFirst, scratch.data());
+
+        float* const dstR = dst + rightOffset();
+        for (uint32_t i = 0; i < kPagePitch; ++i)
+        {
+            int64_t f = start + (int64_t)i;
+            if (f < 0) f = 0;
+            if ((uint64_t)f >= frames) f = (int64_t)frames - 1;
+
+            const uint64_t k = (uint64_t)f - readFirst;
+            if (k >= got)
+            {
+                // short read (truncated file, I/O error): silence
+                dst[i] = 0.0f;
+                dstR[i] = 0.0f;
+                continue;
+            }
+            dst[i] = scratch[(size_t)k * channels];
+            dstR[i] = scratch[(size_t)k * channels + channels - 1];
+        }
+    }
+
+    drwav wav {};
+    bool open = false;
+    uint64_t frames = 0;
+    uint32_t channels = 0;
+    size_t numPages = 0;
+    size_t numSlots = 0;
+
+    std::unique_ptr<std::atomic<const float*>[]> table; // page -> slot data, nullptr when not resident
+    std::vector<float> slotData;                        // numSlots * kPagePitch * channels
+    std::vector<uint64_t> slotPage;                     // service(): page held by each slot
+    std::vector<float> scratch;                         // service(): interleaved decode buffer
+
+    std::mutex mutex;                 // serialises service() and guards readers
+    std::vector<Attachment> readers;
+    mutable std::atomic<uint64_t> misses {0};
+};
+
+// Grain kernel for streamed sources (scalar). Same math as grainKernelScalar, but reads go
+// through the page table; frames whose page is missing are silent. The page pointer is looked
+// up again only when the grain crosses into another page (pages stay put for the whole run()).
+template <bool kStereo, GrainInterp kInterp>
+static void grainKernelStreamed(GrainPool& p, uint32_t g, const GrainKernelArgs& a, uint32_t n, float* busL, float* busR)
+{
+    const SampleStream& s = *a.stream;
+
+    const uint64_t mask = SampleStream::kPageFrames - 1;
+    const uint32_t mode = p.interp[g];
+    const GrainPhase inc = p.inc[g];
+    const float winInc = p.winInc[g];
+    const float gainL = p.gainL[g];
+    const float gainR = p.gainR[g];
+
+    GrainPhase pos = p.pos[g];
+    float winPos = p.winPos[g];
+    uint64_t pageIndex = ~(uint64_t)0;
+    const float* pg = nullptr;
+    uint64_t missed = 0;
+
+    for (uint32_t k = 0; k < n; ++k)
+    {
+        const uint64_t idx = grainPhaseIndex(pos);
+        if ((idx >> SampleStream::kPageShift) != pageIndex)
+        {
+            pageIndex = idx >> SampleStream::kPageShift;
+            pg = s.page(pageIndex);
+        }
+
+        if (pg != nullptr)
+        {
+            // the guards cover every tap, so the read never clamps
+            float vl, vr;
+            GrainReader<kSampleFloat32, kStereo, kInterp>::read(mode, pg, pg + SampleStream::kPagePitch,
+                                                                SampleStream::kGuardBefore + (idx & mask), pos,
+                                                                1, SampleStream::kPagePitch, *a.sinc, vl, vr);
+
+            const float w = GrainWindowTable::read(a.window, winPos);
+            busL[k] += vl * w * gainL;
+            busR[k] += vr * w * gainR;
+        }
+        else
+        {
+            ++missed;
+        }
+
+        pos += inc;
+        winPos += winInc;
+    }
+
+    p.pos[g] = pos;
+    p.winPos[g] = winPos;
+    p.age[g] += n;
+    if (missed != 0)
+        s.addMisses(missed);
+}
+
+static inline GrainKernelFn selectStreamedGrainKernel(GrainInterp interp, uint32_t channels)
+{
+    static const GrainKernelFn fn[kInterpModeCount][2] = {
+        { grainKernelStreamed<false, kInterpLinear>, grainKernelStreamed<true, kInterpLinear> },
+        { grainKernelStreamed<false, kInterpCubic>, grainKernelStreamed<true, kInterpCubic> },
+        { grainKernelStreamed<false, kInterpSinc8>, grainKernelStreamed<true, kInterpSinc8> },
+        { grainKernelStreamed<false, kInterpSinc16>, grainKernelStreamed<true, kInterpSinc16> },
+        { grainKernelStreamed<false, kInterpAuto>, grainKernelStreamed<true, kInterpAuto> },
+    };
+    return fn[interp][channels == 2 ? 1 : 0];
+}
+
+#endif // SAMPLE_STREAM_HPP_INCLUDED
@@ -1,12 +1,17 @@
 /*
 dr_wav - v0.14.0 - public domain
 
-THIS IS A MINIMAL COPY FOR WAV LOADING.
+THIS IS A COMPACT REIMPLEMENTATION OF THE dr_wav API SUBSET GRIST USES.
 Upstream: https://github.com/mackron/dr_libs
 
-NOTE: For brevity in this workspace, we include only what we need.
-If you want the full header with all formats/features, replace this file
-with the official dr_wav.h.
+Supported:
+- RIFF and RF64 containers (64-bit sizes via ds64)
+- PCM 8/16/24/32-bit, IEEE float 32/64-bit, WAVE_FORMAT_EXTENSIBLE wrapping either
+- Block reads into an internal buffer, converted to float with plain loops
+  the compiler vectorises (one fread per DRWAV_READ_BUFFER_SIZE bytes)
+
+Not supported: compressed formats (ADPCM, A-law, mu-law), metadata.
+For those, replace this file with the official dr_wav.h.
 */
 
 #ifndef DR_WAV_H
@@ -19,12 +24,23 @@ extern "C" {
 #include <stddef.h>
 #include <stdint.h>
 
+#define DR_WAVE_FORMAT_PCM          0x1
+#define DR_WAVE_FORMAT_IEEE_FLOAT   0x3
+#define DR_WAVE_FORMAT_EXTENSIBLE   0xFFFE
+
 typedef struct
 {
     uint32_t channels;
     uint32_t sampleRate;
     uint64_t totalPCMFrameCount;
+    uint16_t translatedFormatTag;   /* DR_WAVE_FORMAT_PCM or DR_WAVE_FORMAT_IEEE_FLOAT (EXTENSIBLE resolved) */
+    uint16_t bitsPerSample;         /* container size */
+    uint32_t bytesPerFrame;
+    uint64_t dataChunkDataPos;      /* file offset of the first sample */
+    uint64_t dataChunkDataSize;     /* bytes */
+    uint64_t readCursorInPCMFrames;
     void* pUserData;
+    uint8_t* pReadBuffer;
 } drwav;
 
 typedef size_t (* drwav_read_proc)(void* pUserData, void* pBufferOut, size_t bytesToRead);
@@ -33,12 +49,42 @@ typedef int (* drwav_seek_proc)(void* pUserData, int offset, int origin);
 int drwav_init_file(drwav* pWav, const char* filename, void* pAllocationCallbacks);
 void drwav_uninit(drwav* pWav);
 uint64_t drwav_read_pcm_frames_f32(drwav* pWav, uint64_t framesToRead, float* pBufferOut);
+int drwav_seek_to_pcm_frame(drwav* pWav, uint64_t targetFrameIndex);
+
+/* Sample converters (count = samples, not frames). */
+void drwav_u8_to_f32(float* pOut, const uint8_t* pIn, size_t count);
+void drwav_s16_to_f32(float* pOut, const uint8_t* pIn, size_t count);
+void drwav_s24_to_f32(float* pOut, const uint8_t* pIn, size_t count);
+void drwav_s32_to_f32(float* pOut, const uint8_t* pIn, size_t count);
+void drwav_f32_to_f32(float* pOut, const uint8_t* pIn, size_t count);
+void drwav_f64_to_f32(float* pOut, const uint8_t* pIn, size_t count);
 
-#ifdef DR_WAV_IMPLEMENTATION
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DR_WAV_H
+
+/* Implementation has its own guard so it can be requested after the header was already included. */
+#if defined(DR_WAV_IMPLEMENTATION) && !defined(DR_WAV_IMPLEMENTATION_INCLUDED)
+#define DR_WAV_IMPLEMENTATION_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifndef DRWAV_READ_BUFFER_SIZE
+#define DRWAV_READ_BUFFER_SIZE (256 * 1024)
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+# define DRWAV_BIG_ENDIAN 1
+#endif
+
 static int drwav__read_u32le(FILE* f, uint32_t* out)
 {
     uint8_t b[4];
@@ -47,6 +93,33 @@ static int drwav__read_u32le(FILE* f, uint32_t* out)
     return 1;
 }
 
+static int drwav__read_u64le(FILE* f, uint64_t* out)
+{
+    uint32_t lo, hi;
+    if (!drwav__read_u32le(f,&lo) || !drwav__read_u32le(f,&hi)) return 0;
+    *out = (uint64_t)lo | ((uint64_t)hi<<32);
+    return 1;
+}
+
+/* 64-bit file offsets: sources can be several GB */
+static int drwav__fseek64(FILE* f, int64_t offset, int origin)
+{
+#if defined(_WIN32)
+    return _fseeki64(f, (long long)offset, origin);
+#else
+    return fseeko(f, (off_t)offset, origin);
+#endif
+}
+
+static int64_t drwav__ftell64(FILE* f)
+{
+#if defined(_WIN32)
+    return (int64_t)_ftelli64(f);
+#else
+    return (int64_t)ftello(f);
+#endif
+}
+
 static int drwav__read_u16le(FILE* f, uint16_t* out)
 {
     uint8_t b[2];
@@ -55,15 +128,24 @@ static int drwav__read_u16le(FILE* f, uint16_t* out)
     return 1;
 }
 
+static int drwav__is_supported(uint16_t format, uint16_t bits)
+{
+    if (format == DR_WAVE_FORMAT_PCM)
+        return bits == 8 || bits == 16 || bits == 24 || bits == 32;
+    if (format == DR_WAVE_FORMAT_IEEE_FLOAT)
+        return bits == 32 || bits == 64;
+    return 0;
+}
+
 int drwav_init_file(drwav* pWav, const char* filename, void* /*pAllocationCallbacks*/)
 {
     memset(pWav, 0, sizeof(*pWav));
     FILE* f = fopen(filename, "rb");
     if (!f) return 0;
 
-    // RIFF header
+    // RIFF header (RF64 keeps 64-bit sizes in a ds64 chunk)
     char riff[4];
-    if (fread(riff,1,4,f)!=4 || memcmp(riff,"RIFF",4)!=0) { fclose(f); return 0; }
+    if (fread(riff,1,4,f)!=4 || (memcmp(riff,"RIFF",4)!=0 && memcmp(riff,"RF64",4)!=0)) { fclose(f); return 0; }
     uint32_t riffSize=0; if (!drwav__read_u32le(f,&riffSize)) { fclose(f); return 0; }
     char wave[4];
     if (fread(wave,1,4,f)!=4 || memcmp(wave,"WAVE",4)!=0) { fclose(f); return 0; }
@@ -72,9 +154,11 @@ int drwav_init_file(drwav* pWav, const char* filename, void* /*pAllocationCallba
     uint16_t audioFormat=0;
     uint16_t numChannels=0;
     uint32_t sampleRate=0;
+    uint16_t blockAlign=0;
     uint16_t bitsPerSample=0;
-    uint32_t dataSize=0;
-    long dataPos=0;
+    uint64_t dataSize=0;
+    uint64_t ds64DataSize=0;
+    int64_t dataPos=0;
 
     while (!feof(f))
     {
@@ -83,45 +167,81 @@ int drwav_init_file(drwav* pWav, const char* filename, void* /*pAllocationCallba
         uint32_t chunkSize=0;
         if (!drwav__read_u32le(f,&chunkSize)) break;
 
-        if (memcmp(chunkId,"fmt ",4)==0)
+        if (memcmp(chunkId,"ds64",4)==0)
         {
+            uint64_t riffSize64=0;
+            if (!drwav__read_u64le(f,&riffSize64) || !drwav__read_u64le(f,&ds64DataSize)) { fclose(f); return 0; }
+            if (chunkSize > 16) drwav__fseek64(f, (int64_t)chunkSize - 16, SEEK_CUR);
+        }
+        else if (memcmp(chunkId,"fmt ",4)==0)
+        {
+            if (chunkSize < 16) { fclose(f); return 0; }
             if (!drwav__read_u16le(f,&audioFormat)) { fclose(f); return 0; }
             if (!drwav__read_u16le(f,&numChannels)) { fclose(f); return 0; }
             if (!drwav__read_u32le(f,&sampleRate)) { fclose(f); return 0; }
-            // byte rate + block align
-            uint32_t tmp32; uint16_t tmp16;
-            if (!drwav__read_u32le(f,&tmp32)) { fclose(f); return 0; }
-            if (!drwav__read_u16le(f,&tmp16)) { fclose(f); return 0; }
+            uint32_t byteRate;
+            if (!drwav__read_u32le(f,&byteRate)) { fclose(f); return 0; }
+            if (!drwav__read_u16le(f,&blockAlign)) { fclose(f); return 0; }
             if (!drwav__read_u16le(f,&bitsPerSample)) { fclose(f); return 0; }
+            int64_t remaining = (int64_t)chunkSize - 16;
+
+            // WAVE_FORMAT_EXTENSIBLE: the real format is the first two bytes of the sub-format GUID
+            if (audioFormat == DR_WAVE_FORMAT_EXTENSIBLE && remaining >= 24)
+            {
+                uint16_t cbSize, validBits, subFormat;
+                uint32_t channelMask;
+                if (!drwav__read_u16le(f,&cbSize) || !drwav__read_u16le(f,&validBits) ||
+                    !drwav__read_u32le(f,&channelMask) || !drwav__read_u16le(f,&subFormat)) { fclose(f); return 0; }
+                audioFormat = subFormat;
+                remaining -= 10;
+            }
+
             // skip rest
-            long remaining = (long)chunkSize - 16;
-            if (remaining > 0) fseek(f, remaining, SEEK_CUR);
+            if (remaining > 0) drwav__fseek64(f, remaining, SEEK_CUR);
         }
         else if (memcmp(chunkId,"data",4)==0)
         {
-            dataSize = chunkSize;
-            dataPos = ftell(f);
-            fseek(f, chunkSize, SEEK_CUR);
+            dataPos = drwav__ftell64(f);
+            dataSize = (chunkSize == 0xFFFFFFFFu && ds64DataSize != 0) ? ds64DataSize : chunkSize;
+
+            // data running to the end of the file (or oversized writers' 0xFFFFFFFF): clamp to what is there
+            drwav__fseek64(f, 0, SEEK_END);
+            const int64_t fileEnd = drwav__ftell64(f);
+            if (fileEnd > dataPos && (uint64_t)(fileEnd - dataPos) < dataSize)
+                dataSize = (uint64_t)(fileEnd - dataPos);
+            drwav__fseek64(f, dataPos + (int64_t)dataSize + (int64_t)(dataSize & 1), SEEK_SET);
+            continue;
         }
         else
         {
-            fseek(f, chunkSize, SEEK_CUR);
+            drwav__fseek64(f, chunkSize, SEEK_CUR);
         }
         // pad
-        if (chunkSize & 1) fseek(f, 1, SEEK_CUR);
+        if (chunkSize & 1) drwav__fseek64(f, 1, SEEK_CUR);
     }
 
-    if (audioFormat != 1 || (bitsPerSample != 16 && bitsPerSample != 24 && bitsPerSample != 32) || dataPos == 0)
+    const uint32_t bytesPerFrame = (uint32_t)numChannels * (bitsPerSample / 8);
+    if (!drwav__is_supported(audioFormat, bitsPerSample) || numChannels == 0 || dataPos == 0
+        || (blockAlign != 0 && blockAlign != bytesPerFrame))
     {
         fclose(f);
         return 0;
     }
 
+    pWav->pReadBuffer = (uint8_t*)malloc(DRWAV_READ_BUFFER_SIZE);
+    if (!pWav->pReadBuffer) { fclose(f); return 0; }
+
     // Store file handle in userData
-    fseek(f, dataPos, SEEK_SET);
+    drwav__fseek64(f, dataPos, SEEK_SET);
     pWav->channels = numChannels;
     pWav->sampleRate = sampleRate;
-    pWav->totalPCMFrameCount = (uint64_t)(dataSize / (numChannels * (bitsPerSample/8)));
+    pWav->totalPCMFrameCount = dataSize / bytesPerFrame;
+    pWav->translatedFormatTag = audioFormat;
+    pWav->bitsPerSample = bitsPerSample;
+    pWav->bytesPerFrame = bytesPerFrame;
+    pWav->dataChunkDataPos = (uint64_t)dataPos;
+    pWav->dataChunkDataSize = dataSize;
+    pWav->readCursorInPCMFrames = 0;
     pWav->pUserData = f;
     return 1;
 }
@@ -134,40 +254,142 @@ void drwav_uninit(drwav* pWav)
         fclose(f);
         pWav->pUserData = NULL;
     }
+    if (pWav && pWav->pReadBuffer)
+    {
+        free(pWav->pReadBuffer);
+        pWav->pReadBuffer = NULL;
+    }
+}
+
+int drwav_seek_to_pcm_frame(drwav* pWav, uint64_t targetFrameIndex)
+{
+    FILE* f = (FILE*)pWav->pUserData;
+    if (!f || targetFrameIndex > pWav->totalPCMFrameCount) return 0;
+    const uint64_t offset = pWav->dataChunkDataPos + targetFrameIndex * pWav->bytesPerFrame;
+    if (drwav__fseek64(f, (int64_t)offset, SEEK_SET) != 0) return 0;
+    pWav->readCursorInPCMFrames = targetFrameIndex;
+    return 1;
+}
+
+/*
+Converters. WAV data is little-endian; on little-endian hosts 16/32-bit and float
+samples are loaded directly (memcpy keeps the loads alias- and alignment-safe and
+compiles to plain vector loads), elsewhere they are assembled byte by byte.
+*/
+
+void drwav_u8_to_f32(float* pOut, const uint8_t* pIn, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        pOut[i] = (float)((int32_t)pIn[i] - 128) * (1.0f / 128.0f);
+}
+
+void drwav_s16_to_f32(float* pOut, const uint8_t* pIn, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+#ifdef DRWAV_BIG_ENDIAN
+        const int16_t x = (int16_t)((uint16_t)pIn[i*2] | ((uint16_t)pIn[i*2+1] << 8));
+#else
+        int16_t x;
+        memcpy(&x, pIn + i*2, 2);
+#endif
+        pOut[i] = (float)x * (1.0f / 32768.0f);
+    }
 }
 
-static float drwav__read_s24_as_f32(const uint8_t* b)
+void drwav_s24_to_f32(float* pOut, const uint8_t* pIn, size_t count)
 {
-    int32_t v = (int32_t)(b[0] | (b[1]<<8) | (b[2]<<16));
-    if (v & 0x800000) v |= ~0xFFFFFF;
-    return (float)(v / 8388608.0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint8_t* b = pIn + i*3;
+        // place the 24 bits at the top of an int32 so the arithmetic shift sign-extends
+        const int32_t x = (int32_t)(((uint32_t)b[0] << 8) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 24)) >> 8;
+        pOut[i] = (float)x * (1.0f / 8388608.0f);
+    }
+}
+
+void drwav_s32_to_f32(float* pOut, const uint8_t* pIn, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+#ifdef DRWAV_BIG_ENDIAN
+        const int32_t x = (int32_t)((uint32_t)pIn[i*4] | ((uint32_t)pIn[i*4+1] << 8) | ((uint32_t)pIn[i*4+2] << 16) | ((uint32_t)pIn[i*4+3] << 24));
+#else
+        int32_t x;
+        memcpy(&x, pIn + i*4, 4);
+#endif
+        pOut[i] = (float)x * (1.0f / 2147483648.0f);
+    }
+}
+
+void drwav_f32_to_f32(float* pOut, const uint8_t* pIn, size_t count)
+{
+#ifdef DRWAV_BIG_ENDIAN
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint32_t u = (uint32_t)pIn[i*4] | ((uint32_t)pIn[i*4+1] << 8) | ((uint32_t)pIn[i*4+2] << 16) | ((uint32_t)pIn[i*4+3] << 24);
+        memcpy(pOut + i, &u, 4);
+    }
+#else
+    memcpy(pOut, pIn, count * sizeof(float));
+#endif
+}
+
+void drwav_f64_to_f32(float* pOut, const uint8_t* pIn, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+#ifdef DRWAV_BIG_ENDIAN
+        uint64_t u = 0;
+        for (int k = 7; k >= 0; --k) u = (u << 8) | pIn[i*8 + k];
+        double x;
+        memcpy(&x, &u, 8);
+#else
+        double x;
+        memcpy(&x, pIn + i*8, 8);
+#endif
+        pOut[i] = (float)x;
+    }
 }
 
 uint64_t drwav_read_pcm_frames_f32(drwav* pWav, uint64_t framesToRead, float* pBufferOut)
 {
     FILE* f = (FILE*)pWav->pUserData;
-if (!f) return 0;
+    if (!f || !pWav->pReadBuffer) return 0;
+
+    // never read past the data chunk (trailing LIST/id3 chunks are not audio)
+    const uint64_t remaining = pWav->totalPCMFrameCount - pWav->readCursorInPCMFrames;
+    if (framesToRead > remaining) framesToRead = remaining;
+
+    void (*convert)(float*, const uint8_t*, size_t) = NULL;
+    if (pWav->translatedFormatTag == DR_WAVE_FORMAT_IEEE_FLOAT)
+        convert = (pWav->bitsPerSample == 64) ? drwav_f64_to_f32 : drwav_f32_to_f32;
+    else if (pWav->bitsPerSample == 8)  convert = drwav_u8_to_f32;
+    else if (pWav->bitsPerSample == 16) convert = drwav_s16_to_f32;
+    else if (pWav->bitsPerSample == 24) convert = drwav_s24_to_f32;
+    else                                convert = drwav_s32_to_f32;
+
     const uint32_t ch = pWav->channels;
-    // We only support 16-bit for this minimal build; others return 0.
-    // (If you need 24/32-bit, replace this file with full dr_wav.h.)
-    (void)ch;
-    // detect bits by assuming 16bit (since we didn't store it). minimal limitation.
-    // We'll read as int16.
-    const uint64_t samplesToRead = framesToRead * ch;
-    for (uint64_t i=0;i<samplesToRead;i++)
+    const uint64_t framesPerBlock = DRWAV_READ_BUFFER_SIZE / pWav->bytesPerFrame;
+    uint64_t done = 0;
+    while (done < framesToRead)
     {
-        int16_t s;
-        if (fread(&s, sizeof(int16_t), 1, f) != 1)
-            return i / ch;
-        pBufferOut[i] = (float)(s / 32768.0);
+        uint64_t want = framesToRead - done;
+        if (want > framesPerBlock) want = framesPerBlock;
+
+        const size_t got = fread(pWav->pReadBuffer, pWav->bytesPerFrame, (size_t)want, f);
+        convert(pBufferOut + done * ch, pWav->pReadBuffer, got * ch);
+        done += got;
+        if (got < want)
+            break;
     }
-    return framesToRead;
-}
 
-#endif // DR_WAV_IMPLEMENTATION
+    pWav->readCursorInPCMFrames += done;
+    return done;
+}
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif // DR_WAV_H
+#endif // DR_WAV_IMPLEMENTATION
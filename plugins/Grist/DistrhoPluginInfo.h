@@ -9,10 +9,21 @@
 #ifndef DISTRHO_PLUGIN_INFO_H_INCLUDED
 #define DISTRHO_PLUGIN_INFO_H_INCLUDED
 
+// 1: live-input variant (plugins/GristLive) that granulates its stereo input instead of a file
+#ifndef GRIST_LIVE_INPUT
+# define GRIST_LIVE_INPUT 0
+#endif
+
 #define DISTRHO_PLUGIN_BRAND   "ArchieAudio"
-#define DISTRHO_PLUGIN_NAME    "Grist"
-#define DISTRHO_PLUGIN_URI     "https://example.com/grist" // TODO: replace
-#define DISTRHO_PLUGIN_CLAP_ID "com.archieaudio.grist"
+#if GRIST_LIVE_INPUT
+# define DISTRHO_PLUGIN_NAME    "Grist Live"
+# define DISTRHO_PLUGIN_URI     "https://example.com/grist-live" // TODO: replace
+# define DISTRHO_PLUGIN_CLAP_ID "com.archieaudio.grist-live"
+#else
+# define DISTRHO_PLUGIN_NAME    "Grist"
+# define DISTRHO_PLUGIN_URI     "https://example.com/grist" // TODO: replace
+# define DISTRHO_PLUGIN_CLAP_ID "com.archieaudio.grist"
+#endif
 
 // Plugin type
 #define DISTRHO_PLUGIN_HAS_UI          1
@@ -21,8 +32,15 @@
 #define DISTRHO_PLUGIN_WANT_MIDI_OUTPUT 0
 #define DISTRHO_PLUGIN_WANT_STATE 1
 
-// Synth: no audio inputs, stereo out
-#define DISTRHO_PLUGIN_NUM_INPUTS      0
+// The UI reads the waveform overview straight from the DSP instance
+#define DISTRHO_PLUGIN_WANT_DIRECT_ACCESS 1
+
+// Synth: no audio inputs, stereo out (live variant: stereo in, captured for the grains)
+#if GRIST_LIVE_INPUT
+# define DISTRHO_PLUGIN_NUM_INPUTS     2
+#else
+# define DISTRHO_PLUGIN_NUM_INPUTS     0
+#endif
 #define DISTRHO_PLUGIN_NUM_OUTPUTS     2
 
 #define DISTRHO_UI_USE_NANOVG          1
@@ -47,6 +65,17 @@ enum Parameters {
     kParamReleaseMs,
     kParamKillOnRetrig,
     kParamNewVoiceOnRetrig,
+    kParamWindowShape,
+    kParamSpawnMode,
+    kParamLoudnessNorm,
+    kParamNormThresholdDb,
+    kParamSwapFadeMs,
+    kParamInterpolation,
+#if GRIST_LIVE_INPUT
+    kParamFreeze,
+    kParamDrone,
+#endif
+    kParamStreamMisses,
     kParamCount
 };
 
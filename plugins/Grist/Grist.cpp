@@ -11,6 +11,7 @@
 
 #define DR_WAV_IMPLEMENTATION
 #include "DSP/dr_wav.h"
+#include "DSP/Resampler.hpp"
 
 #include <cmath>
 #include <algorithm>
@@ -30,16 +31,8 @@ static inline float lerp(const float a, const float b, const float t)
     return a + (b - a) * t;
 }
 
-static inline float catmullRom(const float y0, const float y1, const float y2, const float y3, const float t)
-{
-    // Catmull-Rom spline (cubic), reasonably good for sample playback
-    const float t2 = t * t;
-    const float t3 = t2 * t;
-    return 0.5f * ((2.0f * y1) + (-y0 + y2) * t + (2.0f*y0 - 5.0f*y1 + 4.0f*y2 - y3) * t2 + (-y0 + 3.0f*y1 - 3.0f*y2 + y3) * t3);
-}
-
 Grist::Grist()
-    : Plugin(kParamCount, 0, 5), // params, programs, states
+    : Plugin(kParamCount, 0, kStateCount), // params, programs, states
       fGain(0.8f),
       fGrainSizeMs(60.0f),
       fDensity(20.0f),
@@ -53,14 +46,38 @@ Grist::Grist()
       fReleaseMs(120.0f),
       fKillOnRetrig(1.0f),
       fNewVoiceOnRetrig(0.0f),
+      fWindowShape((float)kWindowHann),
+      fSpawnMode((float)kSpawnFree),
+      fLoudnessNorm(0.0f),
+      fNormThresholdDb(-60.0f),
+      fSwapFadeMs(50.0f),
+      fInterpolation((float)kInterpCubic),
+#if GRIST_LIVE_INPUT
+      fFreeze(0.0f),
+      fDrone(1.0f),
+#endif
+      fStreamMisses(0.0f),
       fSampleRate(48000.0),
       gateOn(false),
       currentNote(60),
-      currentVelocity(0.8f)
+      currentVelocity(0.8f),
+      grains(kGrainPoolCapacity),
+      fadingGrains(kGrainPoolCapacity),
+      grainKernels(selectGrainKernels()),
+      loader(*this),
+      streamReader(*this)
 {
     vizEventCount = 0;
     vizDecim = 0;
 
+    if (getSampleRate() > 1.0)
+        fSampleRate = getSampleRate();
+    targetRate.store(fSampleRate);
+
+    // build the shared window and interpolation tables here, not on the audio thread
+    GrainWindowTable::instance();
+    GrainSincTables::instance();
+
     // voices init
     for (uint32_t v = 0; v < kMaxVoices; ++v)
     {
@@ -72,12 +89,29 @@ Grist::Grist()
         voices[v].env = 0.0f;
         voices[v].pitchEnv = 0.0f;
         voices[v].samplesToNextGrain = 0.0;
-        for (uint32_t g = 0; g < Voice::kMaxGrains; ++g)
-            voices[v].grains[g].active = false;
     }
 
     for (uint32_t n = 0; n < 128; ++n)
         noteQueues[n].clear();
+
+    loader.startRunner(10);
+    streamReader.startRunner(5);
+}
+
+Grist::~Grist()
+{
+    // cancel any in-flight decode, then join the loader
+    requestSerial.fetch_add(1);
+    loader.stopRunner();
+    streamReader.stopRunner();
+
+    // no other thread touches the hand-off anymore
+    drainRetiredSamples();
+    delete pendingSample.exchange(nullptr);
+    delete currentSample;
+    delete queuedSample;
+    delete fadingSample;
+    currentSample = queuedSample = fadingSample = nullptr;
 }
 
 uint32_t Grist::rngU32()
@@ -107,26 +141,53 @@ void Grist::activate()
         voices[v].env = 0.0f;
         voices[v].pitchEnv = 0.0f;
         voices[v].samplesToNextGrain = 0.0;
-        for (uint32_t g = 0; g < Voice::kMaxGrains; ++g)
-            voices[v].grains[g].active = false;
     }
 
+    grains.clear();
+    fadingGrains.clear(); // fadingSample is retired by the next acquireSample()
+
     for (uint32_t n = 0; n < 128; ++n)
         noteQueues[n].clear();
 
     // Try loading default sample location on activate (no dialogs needed).
-    {
-        std::lock_guard<std::mutex> lock(sampleMutex);
-        if (sample)
-            return;
-    }
+    // Queued only: activation never waits for decoding, and never replaces a pending request.
+    if (haveSample.load() || requestSerial.load() != completedSerial.load())
+        return;
 
-    loadDefaultSample();
+#if GRIST_LIVE_INPUT
+    requestSampleLoad("__CAPTURE__");
+#else
+    requestSampleLoad("__DEFAULT__");
+#endif
 }
 
 void Grist::sampleRateChanged(double newSampleRate)
 {
     fSampleRate = newSampleRate > 1.0 ? newSampleRate : 48000.0;
+    targetRate.store(fSampleRate);
+
+#if GRIST_LIVE_INPUT
+    // the capture ring runs at the host rate
+    if (haveSample.load() && publishedRate.load() != (uint32_t)std::lround(fSampleRate))
+        requestSampleLoad("__CAPTURE__");
+    return;
+#endif
+
+    // in-memory samples were converted to the old rate: convert again from the file
+    if (resampleOnLoad.load() && publishedInMemory.load()
+        && publishedRate.load() != (uint32_t)std::lround(fSampleRate))
+        reloadCurrentSample();
+}
+
+void Grist::reloadCurrentSample()
+{
+    std::string path;
+    {
+        const std::lock_guard<std::mutex> lock(requestMutex);
+        path = loadedPath;
+    }
+    if (!path.empty())
+        requestSampleLoad(path.c_str());
 }
 
 void Grist::initState(uint32_t index, State& state)
@@ -166,6 +227,64 @@ void Grist::initState(uint32_t index, State& state)
         state.hints = 0;
         state.label = "Grain Active Viz";
     }
+    else if (index == 5)
+    {
+        state.key = "stream_cache_mb";
+        state.defaultValue = "0";
+        state.hints = 0;
+        state.label = "Stream Cache (MB)";
+        state.description = "Files that cannot be memory-mapped and would take more RAM than this once decoded are streamed from disk through a cache of this size; 0 (default) loads everything into RAM. Applies to the next load.";
+    }
+    else if (index == 6)
+    {
+        state.key = "resample";
+        state.defaultValue = "1";
+        state.hints = 0;
+        state.label = "Resample On Load";
+        state.description = "1: convert in-memory samples to the host rate with a windowed-sinc resampler when loading. 0: play at the file rate (pitch-corrected per grain).";
+    }
+    else if (index == 7)
+    {
+        state.key = "sample_format";
+        state.defaultValue = "float";
+        state.hints = 0;
+        state.label = "Sample Format";
+        state.description = "How loaded samples are kept in memory. float: full quality. int16 / half: half the memory and read bandwidth (int16: -96 dBFS floor; half: ~-66 dB relative).";
+    }
+    else if (index == 8)
+    {
+        state.key = "disk_cache";
+        state.defaultValue = "0";
+        state.hints = 0;
+        state.label = "Disk Cache";
+        state.description = "1: keep decoded samples in $XDG_CACHE_HOME/grist so later loads map them directly instead of decoding the WAV again.";
+    }
+    else if (index == 9)
+    {
+        state.key = "mipmaps";
+        state.defaultValue = "1";
+        state.hints = 0;
+        state.label = "Mipmaps";
+        state.description = "1: keep band-limited half-rate copies of in-memory samples (about 2x the memory) so pitched-up grains read without aliasing. Applies to the next load.";
+    }
+    else if (index == 10)
+    {
+        state.key = "lock_mb";
+        state.defaultValue = "0";
+        state.hints = 0;
+        state.label = "Lock Memory (MB)";
+        state.description = "Prefault and mlock up to this many MB of each loaded sample so grain reads never page-fault; 0 disables. Applies to the next load.";
+    }
+#if GRIST_LIVE_INPUT
+    else if (index == 11)
+    {
+        state.key = "capture_seconds";
+        state.defaultValue = "8";
+        state.hints = 0;
+        state.label = "Capture Length";
+        state.description = "Seconds of input history (1-60) the grains can reach back into. Changing it starts a new, empty capture buffer.";
+    }
+#endif
 }
 
 void Grist::setState(const char* key, const char* value)
@@ -177,43 +296,496 @@ void Grist::setState(const char* key, const char* value)
     if (std::strcmp(key, "sample_status") == 0 || std::strcmp(key, "sample_error") == 0 || std::strcmp(key, "grains") == 0 || std::strcmp(key, "grains_active") == 0)
         return;
 
+    if (std::strcmp(key, "stream_cache_mb") == 0)
+    {
+        if (value != nullptr && value[0] != '\0')
+            streamCacheMb.store((uint32_t)std::max(0, std::min(std::atoi(value), 65536)));
+        return;
+    }
+
+    if (std::strcmp(key, "resample") == 0)
+    {
+        const bool on = value != nullptr && std::atoi(value) != 0;
+        if (resampleOnLoad.exchange(on) != on && publishedInMemory.load())
+            reloadCurrentSample();
+        return;
+    }
+
+#if GRIST_LIVE_INPUT
+    if (std::strcmp(key, "capture_seconds") == 0)
+    {
+        const float seconds = (value != nullptr && value[0] != '\0') ? fclampf((float)std::atof(value), 1.0f, 60.0f) : 8.0f;
+        if (captureSeconds.exchange(seconds) != seconds && haveSample.load())
+            requestSampleLoad("__CAPTURE__");
+        return;
+    }
+
+    // the live variant only granulates its input
+    if (std::strcmp(key, "sample") == 0)
+        return;
+#endif
+
+    if (std::strcmp(key, "mipmaps") == 0)
+    {
+        mipmapsOn.store(value == nullptr || std::atoi(value) != 0);
+        return;
+    }
+
+    if (std::strcmp(key, "lock_mb") == 0)
+    {
+        if (value != nullptr && value[0] != '\0')
+            lockBudgetMb.store((uint32_t)std::max(0, std::min(std::atoi(value), 65536)));
+        return;
+    }
+
+    if (std::strcmp(key, "disk_cache") == 0)
+    {
+        diskCacheOn.store(value != nullptr && std::atoi(value) != 0);
+        return;
+    }
+
+    if (std::strcmp(key, "sample_format") == 0)
+    {
+        const uint32_t f = (uint32_t)sampleFormatFromName(value);
+        if (sampleFormat.exchange(f) != f && haveSample.load())
+            reloadCurrentSample();
+        return;
+    }
+
     if (std::strcmp(key, "sample") != 0)
         return;
 
     if (value == nullptr || value[0] == '\0')
         return;
 
-    lastSampleError.clear();
+    requestSampleLoad(value);
+}
 
-    bool ok = false;
-    if (std::strcmp(value, "__DEFAULT__") == 0)
+void Grist::requestSampleLoad(const char* path)
+{
     {
-        ok = loadDefaultSample();
+        const std::lock_guard<std::mutex> lock(requestMutex);
+        pendingPath = path;
+    }
+    requestSerial.fetch_add(1, std::memory_order_release);
+    updateStateValue("sample_status", "loading");
+}
+
+bool Grist::loadCancelled() const
+{
+    return requestSerial.load(std::memory_order_relaxed) != loaderSerial;
+}
+
+void Grist::reportLoadProgress(uint64_t done, uint64_t total, int& lastPercent)
+{
+    const int percent = total > 0 ? (int)((done * 100) / total) : 100;
+    if (percent < lastPercent + 5)
+        return;
+    lastPercent = percent;
+
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "loading %d%%", percent);
+    updateStateValue("sample_status", buf);
+}
+
+void Grist::publishSample(const std::shared_ptr<const SampleData>& s)
+{
+    SampleRef* const ref = new SampleRef(s, streamRead);
+    loaderSample = s;
+    prefetchedBegin = prefetchedEnd = 0;
+    publishedRate.store(s->sampleRate);
+    publishedInMemory.store((!s->map.isOpen() || s->diskCached) && !s->stream);
+
+    {
+        const std::lock_guard<std::mutex> lock(streamMutex);
+        // a streamed sample the audio thread is playing may still play out in a swap crossfade
+        if (streamSample && streamSample != s && playingSample.load(std::memory_order_acquire) == streamSample.get())
+            fadingStreamSample = streamSample;
+        streamSample = s->stream ? s : nullptr;
+    }
+
+    // An unconsumed older ref was never seen by the audio thread: safe to delete here.
+    delete pendingSample.exchange(ref, std::memory_order_acq_rel);
+    haveSample.store(true);
+}
+
+void Grist::publishAnalysis(const std::shared_ptr<const SampleAnalysis>& a)
+{
+    if (!loaderSample)
+        return;
+
+    // same data, now with its index: the audio thread swaps refs exactly as for a new sample
+    SampleRef* const ref = new SampleRef(loaderSample, streamRead);
+    ref->analysis = a;
+    delete pendingSample.exchange(ref, std::memory_order_acq_rel);
+}
+
+void Grist::lockSampleMemory(const SampleData& s)
+{
+    const size_t budget = (size_t)lockBudgetMb.load() << 20;
+    const std::lock_guard<std::mutex> lock(s.lockMutex);
+    if (budget <= s.lockBudget)
+        return;
+
+    // level 0 first (every grain reads it), then the mips; a budget that runs out locks a prefix.
+    // A sample shared with an instance that locked less only gets the part past its budget.
+    size_t had = s.lockBudget, want = budget, total = 0;
+    const auto pin = [&](const void* p, size_t bytes) {
+        const size_t from = std::min(bytes, had);
+        const size_t to = std::min(bytes, want);
+        if (to > from)
+            s.locked.lock(static_cast<const uint8_t*>(p) + from, to - from, to - from, s.lockError);
+        s.lockWanted += to - from;
+        total += bytes;
+        had -= from;
+        want -= to;
+    };
+
+    if (s.map.isOpen())
+    {
+        // mapped WAV or disk cache entry: frames (and cached mips) up to the end of the file
+        pin(s.map.data() + s.mapDataOffset, s.map.size() - s.mapDataOffset);
+    }
+    else if (s.stream)
+    {
+        // the audio thread reads the page cache slots, never the file
+        pin(s.stream->cacheData(), s.stream->cacheBytes());
+    }
+    else
+    {
+        pin(s.storageL.data(), s.storageL.size() * sizeof(float));
+        pin(s.storageR.data(), s.storageR.size() * sizeof(float));
+        pin(s.packedL.data(), s.packedL.size() * sizeof(uint16_t));
+        pin(s.packedR.data(), s.packedR.size() * sizeof(uint16_t));
+        pin(s.mipStorage.data(), s.mipStorage.size() * sizeof(float));
+        pin(s.mipPacked.data(), s.mipPacked.size() * sizeof(uint16_t));
+    }
+
+    s.lockTotal = total;
+    s.lockBudget = budget;
+}
+
+void Grist::drainRetiredSamples()
+{
+    // Dropping the last reference frees the sample data here, off the audio thread.
+    while (SampleRef* const r = retiredSamples.pop())
+        delete r;
+}
+
+const Grist::SampleData* Grist::acquireSample(uint32_t fadeFrames)
+{
+    // Every step below hands at most one ref back, and only when the retire queue has room.
+
+    // crossfade over (or nothing left to fade): the old data goes back to the loader
+    if (fadingSample != nullptr && (fadeRemaining == 0 || fadingGrains.activeCount() == 0) && !retiredSamples.full())
+    {
+        fadingGrains.clear();
+        retiredSamples.push(fadingSample);
+        fadingSample = nullptr;
+    }
+
+    // take the newest posted ref; a queued one it supersedes was never played
+    if (pendingSample.load(std::memory_order_relaxed) != nullptr && !retiredSamples.full())
+    {
+        if (SampleRef* const next = pendingSample.exchange(nullptr, std::memory_order_acq_rel))
+        {
+            if (queuedSample != nullptr)
+                retiredSamples.push(queuedSample);
+            queuedSample = next;
+        }
+    }
+
+    if (queuedSample != nullptr && !retiredSamples.full())
+    {
+        if (currentSample == nullptr)
+        {
+            currentSample = queuedSample;
+            queuedSample = nullptr;
+        }
+        else if (queuedSample->data == currentSample->data)
+        {
+            // same data (e.g. now carrying its onset index): grains are unaffected
+            retiredSamples.push(currentSample);
+            currentSample = queuedSample;
+            queuedSample = nullptr;
+        }
+        else if (fadingSample == nullptr)
+        {
+            // new data: playing grains finish on the old one while new grains start on this one
+            if (grains.activeCount() > 0 && fadeFrames > 0)
+            {
+                fadingGrains.swap(grains); // both pools: no allocation, and fadingGrains was empty
+                fadingSample = currentSample;
+                fadeLength = fadeRemaining = fadeFrames;
+            }
+            else
+            {
+                grains.clear();
+                retiredSamples.push(currentSample);
+            }
+            currentSample = queuedSample;
+            queuedSample = nullptr;
+        }
+    }
+
+    return currentSample != nullptr ? currentSample->data.get() : nullptr;
+}
+
+void Grist::prefetchMappedSample()
+{
+    if (!loaderSample || !loaderSample->map.isOpen())
+        return;
+
+    uint64_t begin, end;
+    prefetchWindow(*loaderSample, begin, end);
+    if (end <= begin || (begin == prefetchedBegin && end == prefetchedEnd))
+        return;
+    prefetchedBegin = begin;
+    prefetchedEnd = end;
+
+    const SampleData& s = *loaderSample;
+    const size_t frameBytes = sampleFormatBytes(s.format) * s.stride;
+    s.map.prefetch(s.mapDataOffset + (size_t)begin * frameBytes, (size_t)(end - begin) * frameBytes);
+
+    // planar (disk cache): the right channel is a separate range
+    if (s.channels == 2 && s.stride == 1)
+    {
+        const size_t offsetR = (size_t)(static_cast<const uint8_t*>(s.R) - s.map.data());
+        s.map.prefetch(offsetR + (size_t)begin * frameBytes, (size_t)(end - begin) * frameBytes);
+    }
+}
+
+void Grist::prefetchWindow(const SampleData& s, uint64_t& begin, uint64_t& end) const
+{
+    const double span = s.frames >= 2 ? (double)(s.frames - 2) : 0.0;
+    const double hi = prefetchHi.load(std::memory_order_relaxed) * span
+                    + prefetchReach.load(std::memory_order_relaxed) * (double)s.sampleRate;
+    begin = (uint64_t)(prefetchLo.load(std::memory_order_relaxed) * span);
+    end = (uint64_t)std::min(hi, (double)s.frames);
+}
+
+void Grist::streamIdle()
+{
+    std::shared_ptr<const SampleData> s, f;
+    {
+        const std::lock_guard<std::mutex> lock(streamMutex);
+        s = streamSample;
+        f = fadingStreamSample;
+    }
+
+    uint64_t begin, end;
+    if (s)
+    {
+        prefetchWindow(*s, begin, end);
+        s->stream->service(streamRead, begin, end);
+    }
+
+    // the replaced stream: its fading grains' window while it crossfades out, the spawn
+    // window while the audio thread still plays it; dropped once it does neither
+    if (!f)
+        return;
+    const SampleData* const playing = playingSample.load(std::memory_order_acquire);
+    if (fadePrefetchFor.load(std::memory_order_acquire) == f.get())
+    {
+        f->stream->service(streamRead, fadePrefetchBegin.load(std::memory_order_relaxed),
+                           fadePrefetchEnd.load(std::memory_order_relaxed));
+    }
+    else if (playing == f.get())
+    {
+        prefetchWindow(*f, begin, end);
+        f->stream->service(streamRead, begin, end);
     }
     else
     {
-        ok = loadWavFile(value);
+        const std::lock_guard<std::mutex> lock(streamMutex);
+        if (fadingStreamSample == f)
+            fadingStreamSample.reset();
+    }
+}
+
+void Grist::loaderIdle()
+{
+    drainRetiredSamples();
+    prefetchMappedSample();
+
+    const uint32_t serial = requestSerial.load(std::memory_order_acquire);
+    if (serial == loaderSerial)
+        return;
+    loaderSerial = serial;
+
+    std::string path;
+    {
+        const std::lock_guard<std::mutex> lock(requestMutex);
+        path = pendingPath;
     }
 
+    lastSampleError.clear();
+
+    bool ok = false;
+    if (path == "__DEFAULT__")
+        ok = loadDefaultSample();
+#if GRIST_LIVE_INPUT
+    else if (path == "__CAPTURE__")
+        ok = createCaptureBuffer();
+#endif
+    else
+        ok = loadWavFile(path.c_str());
+
+    // superseded by a newer request: that one reports its own status
+    if (loadCancelled())
+        return;
+
+    completedSerial.store(serial);
+
     if (ok)
     {
         // Push the resolved path back into the state so the UI (and host) have the real filename
         // even when the UI requests "__DEFAULT__".
+        if (loaderSample && loaderSample->capture == nullptr)
+        {
+            {
+                const std::lock_guard<std::mutex> lock(requestMutex);
+                loadedPath = loaderSample->path;
+            }
+            updateStateValue("sample", loaderSample->path.c_str());
+        }
+        // resident-memory outcome rides along with "ok"
+        char status[128] = "ok";
+        if (loaderSample)
         {
-            std::lock_guard<std::mutex> lock(sampleMutex);
-            if (sample)
-                updateStateValue("sample", sample->path.c_str());
+            // a shared sample reports its one record: at least this instance's budget, or why not
+            const SampleData& s = *loaderSample;
+            const std::lock_guard<std::mutex> lock(s.lockMutex);
+            const unsigned long lockedMb = (unsigned long)((s.locked.lockedBytes() + (1u << 20) - 1) >> 20);
+            const unsigned long wantedMb = (unsigned long)((s.lockWanted + (1u << 20) - 1) >> 20);
+            const unsigned long totalMb = (unsigned long)((s.lockTotal + (1u << 20) - 1) >> 20);
+            if (s.lockError != 0)
+                std::snprintf(status, sizeof(status), "ok, lock failed: %s (%lu of %lu MB locked)",
+                              std::strerror(s.lockError), lockedMb, wantedMb);
+            else if (s.lockWanted != 0 && s.lockWanted < s.lockTotal)
+                std::snprintf(status, sizeof(status), "ok, %lu of %lu MB locked (budget)", lockedMb, totalMb);
+            else if (s.lockWanted != 0)
+                std::snprintf(status, sizeof(status), "ok, %lu MB locked", lockedMb);
         }
-        updateStateValue("sample_status", "ok");
+        updateStateValue("sample_status", status);
         updateStateValue("sample_error", "");
+
+        // the sample already plays; the overview and onset index follow
+        if (loaderSample && loaderSample->capture == nullptr)
+            analyseSample(*loaderSample);
     }
     else
     {
+        // the previous sample (if any) stays published and keeps playing
         updateStateValue("sample_status", "error");
         updateStateValue("sample_error", lastSampleError.empty() ? "Failed to load sample" : lastSampleError.c_str());
     }
 }
 
+// Mono mix of frames [begin, begin + n) of a decoded or mapped source, for the analysis pass.
+template <SampleFormat kFormat>
+static void mixPeakChunk(const void* L, const void* R, size_t stride, size_t begin, size_t n, float* mono)
+{
+    typedef SampleCodec<kFormat> Codec;
+    const typename Codec::Storage* const l = static_cast<const typename Codec::Storage*>(L);
+    const typename Codec::Storage* const r = static_cast<const typename Codec::Storage*>(R);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const size_t k = (begin + i) * stride;
+        mono[i] = 0.5f * (Codec::load(l, k) + Codec::load(r, k)) * Codec::kScale;
+    }
+}
+
+void Grist::analyseSample(const SampleData& s)
+{
+    // another instance may have analysed this file already
+    const std::string key = sampleCacheKey(s.path.c_str(), 0, 0, 0);
+    std::shared_ptr<const PeakPyramid> pyramid = PeakCache::instance().find(key);
+    std::shared_ptr<const SampleAnalysis> analysis = AnalysisCache::instance().find(key);
+
+    if (!pyramid || !analysis)
+    {
+        // one pass feeds both; whichever was cached is rebuilt alongside but not replaced
+        std::shared_ptr<PeakPyramid> built(new PeakPyramid(s.frames));
+        std::shared_ptr<SampleAnalysis> index(new SampleAnalysis(s.frames));
+        const size_t chunkFrames = 1u << 14;
+        std::vector<float> mono(chunkFrames);
+
+        if (s.stream)
+        {
+            // not resident: one sequential pass over the file with a decoder of our own
+            drwav wav;
+            if (!drwav_init_file(&wav, s.path.c_str(), nullptr))
+                return;
+            const uint32_t ch = wav.channels;
+            std::vector<float> interleaved(chunkFrames * ch);
+            for (;;)
+            {
+                if (loadCancelled())
+                {
+                    drwav_uninit(&wav);
+                    return;
+                }
+                const size_t got = (size_t)drwav_read_pcm_frames_f32(&wav, chunkFrames, interleaved.data());
+                if (got == 0)
+                    break;
+                for (size_t i = 0; i < got; ++i)
+                    mono[i] = 0.5f * (interleaved[i * ch] + interleaved[i * ch + ch - 1]);
+                built->add(mono.data(), got);
+                index->add(mono.data(), got);
+            }
+            drwav_uninit(&wav);
+        }
+        else
+        {
+            for (size_t pos = 0; pos < s.frames; pos += chunkFrames)
+            {
+                // a newer load will build its own
+                if (loadCancelled())
+                    return;
+
+                const size_t n = std::min(chunkFrames, s.frames - pos);
+                if (s.format == kSampleInt16)
+                    mixPeakChunk<kSampleInt16>(s.L, s.R, s.stride, pos, n, mono.data());
+                else if (s.format == kSampleHalf)
+                    mixPeakChunk<kSampleHalf>(s.L, s.R, s.stride, pos, n, mono.data());
+                else
+                    mixPeakChunk<kSampleFloat32>(s.L, s.R, s.stride, pos, n, mono.data());
+                built->add(mono.data(), n);
+                index->add(mono.data(), n);
+            }
+        }
+
+        built->finish();
+        index->finish();
+        if (!pyramid)
+        {
+            PeakCache::instance().insert(key, built);
+            pyramid = built;
+        }
+        if (!analysis)
+        {
+            AnalysisCache::instance().insert(key, index);
+            analysis = index;
+        }
+    }
+
+    publishAnalysis(analysis);
+
+    {
+        const std::lock_guard<std::mutex> lock(peaksMutex);
+        peaks = pyramid;
+    }
+    peaksSerial.fetch_add(1, std::memory_order_release);
+}
+
+std::shared_ptr<const PeakPyramid> Grist::peakPyramid(uint32_t& serial)
+{
+    serial = peaksSerial.load(std::memory_order_acquire);
+    const std::lock_guard<std::mutex> lock(peaksMutex);
+    return peaks;
+}
+
 void Grist::initParameter(uint32_t index, Parameter& parameter)
 {
     parameter.hints = kParameterIsAutomatable;
@@ -335,44 +907,183 @@ void Grist::initParameter(uint32_t index, Parameter& parameter)
         parameter.ranges.min = 0.0f;
         parameter.ranges.max = 1.0f;
         break;
-    }
-}
 
-float Grist::getParameterValue(uint32_t index) const
-{
-    switch (index)
+    case kParamWindowShape:
     {
-    case kParamGain: return fGain;
-    case kParamGrainSizeMs: return fGrainSizeMs;
-    case kParamDensity: return fDensity;
-    case kParamPosition: return fPosition * 100.0f;
-    case kParamSpray: return fSpray * 100.0f;
-    case kParamPitch: return fPitch;
-    case kParamRandomPitch: return fRandomPitch;
-    case kParamPitchEnvAmt: return fPitchEnvAmt;
-    case kParamPitchEnvDecayMs: return fPitchEnvDecayMs;
-    case kParamAttackMs: return fAttackMs;
-    case kParamReleaseMs: return fReleaseMs;
-    case kParamKillOnRetrig: return fKillOnRetrig;
-    case kParamNewVoiceOnRetrig: return fNewVoiceOnRetrig;
-    default: return 0.0f;
+        parameter.name = "Window";
+        parameter.symbol = "window_shape";
+        parameter.hints |= kParameterIsInteger;
+        parameter.ranges.def = (float)kWindowHann;
+        parameter.ranges.min = 0.0f;
+        parameter.ranges.max = (float)(kWindowShapeCount - 1);
+
+        ParameterEnumerationValue* const values = new ParameterEnumerationValue[kWindowShapeCount];
+        values[0].label = "Hann";
+        values[0].value = (float)kWindowHann;
+        values[1].label = "Tukey";
+        values[1].value = (float)kWindowTukey;
+        values[2].label = "Gaussian";
+        values[2].value = (float)kWindowGaussian;
+        values[3].label = "Trapezoid";
+        values[3].value = (float)kWindowTrapezoid;
+        parameter.enumValues.count = kWindowShapeCount;
+        parameter.enumValues.restrictedMode = true;
+        parameter.enumValues.values = values;
+        break;
     }
-}
 
-void Grist::setParameterValue(uint32_t index, float value)
-{
-    switch (index)
+    case kParamSpawnMode:
     {
-    case kParamGain:
-        fGain = fclampf(value, 0.0f, 1.0f);
-        break;
-    case kParamGrainSizeMs:
-        fGrainSizeMs = fclampf(value, 5.0f, 250.0f);
-        break;
-    case kParamDensity:
-        fDensity = fclampf(value, 1.0f, 80.0f);
+        parameter.name = "Spawn";
+        parameter.symbol = "spawn_mode";
+        parameter.hints |= kParameterIsInteger;
+        parameter.ranges.def = (float)kSpawnFree;
+        parameter.ranges.min = 0.0f;
+        parameter.ranges.max = (float)(kSpawnModeCount - 1);
+
+        ParameterEnumerationValue* const values = new ParameterEnumerationValue[kSpawnModeCount];
+        values[0].label = "Free";
+        values[0].value = (float)kSpawnFree;
+        values[1].label = "Snap to Onset";
+        values[1].value = (float)kSpawnOnsets;
+        values[2].label = "Skip Silence";
+        values[2].value = (float)kSpawnAudible;
+        parameter.enumValues.count = kSpawnModeCount;
+        parameter.enumValues.restrictedMode = true;
+        parameter.enumValues.values = values;
         break;
-    case kParamPosition:
+    }
+
+    case kParamLoudnessNorm:
+        parameter.name = "Normalize";
+        parameter.symbol = "loudness_norm";
+        parameter.hints |= kParameterIsBoolean;
+        parameter.ranges.def = 0.0f;
+        parameter.ranges.min = 0.0f;
+        parameter.ranges.max = 1.0f;
+        break;
+
+    case kParamNormThresholdDb:
+        parameter.name = "Norm Threshold";
+        parameter.symbol = "norm_threshold";
+        parameter.unit = "dB";
+        parameter.ranges.def = -60.0f;
+        parameter.ranges.min = -96.0f;
+        parameter.ranges.max = 0.0f;
+        break;
+
+    case kParamSwapFadeMs:
+        parameter.name = "Swap Fade";
+        parameter.symbol = "swap_fade";
+        parameter.unit = "ms";
+        parameter.ranges.def = 50.0f;
+        parameter.ranges.min = 0.0f;
+        parameter.ranges.max = 1000.0f;
+        break;
+
+    case kParamInterpolation:
+    {
+        parameter.name = "Interpolation";
+        parameter.symbol = "interpolation";
+        parameter.hints |= kParameterIsInteger;
+        parameter.ranges.def = (float)kInterpCubic;
+        parameter.ranges.min = 0.0f;
+        parameter.ranges.max = (float)(kInterpModeCount - 1);
+
+        ParameterEnumerationValue* const values = new ParameterEnumerationValue[kInterpModeCount];
+        values[0].label = "Linear";
+        values[0].value = (float)kInterpLinear;
+        values[1].label = "Cubic";
+        values[1].value = (float)kInterpCubic;
+        values[2].label = "Sinc 8";
+        values[2].value = (float)kInterpSinc8;
+        values[3].label = "Sinc 16";
+        values[3].value = (float)kInterpSinc16;
+        values[4].label = "Auto";
+        values[4].value = (float)kInterpAuto;
+        parameter.enumValues.count = kInterpModeCount;
+        parameter.enumValues.restrictedMode = true;
+        parameter.enumValues.values = values;
+        break;
+    }
+
+#if GRIST_LIVE_INPUT
+    case kParamFreeze:
+        parameter.name = "Freeze";
+        parameter.symbol = "freeze";
+        parameter.hints |= kParameterIsBoolean;
+        parameter.ranges.def = 0.0f;
+        parameter.ranges.min = 0.0f;
+        parameter.ranges.max = 1.0f;
+        break;
+
+    case kParamDrone:
+        parameter.name = "Drone";
+        parameter.symbol = "drone";
+        parameter.hints |= kParameterIsBoolean;
+        parameter.ranges.def = 1.0f;
+        parameter.ranges.min = 0.0f;
+        parameter.ranges.max = 1.0f;
+        break;
+#endif
+
+    case kParamStreamMisses:
+        parameter.name = "Stream Misses";
+        parameter.symbol = "stream_misses";
+        parameter.hints = kParameterIsOutput | kParameterIsInteger;
+        parameter.ranges.def = 0.0f;
+        parameter.ranges.min = 0.0f;
+        parameter.ranges.max = 1e9f;
+        break;
+    }
+}
+
+float Grist::getParameterValue(uint32_t index) const
+{
+    switch (index)
+    {
+    case kParamGain: return fGain;
+    case kParamGrainSizeMs: return fGrainSizeMs;
+    case kParamDensity: return fDensity;
+    case kParamPosition: return fPosition * 100.0f;
+    case kParamSpray: return fSpray * 100.0f;
+    case kParamPitch: return fPitch;
+    case kParamRandomPitch: return fRandomPitch;
+    case kParamPitchEnvAmt: return fPitchEnvAmt;
+    case kParamPitchEnvDecayMs: return fPitchEnvDecayMs;
+    case kParamAttackMs: return fAttackMs;
+    case kParamReleaseMs: return fReleaseMs;
+    case kParamKillOnRetrig: return fKillOnRetrig;
+    case kParamNewVoiceOnRetrig: return fNewVoiceOnRetrig;
+    case kParamWindowShape: return fWindowShape;
+    case kParamSpawnMode: return fSpawnMode;
+    case kParamLoudnessNorm: return fLoudnessNorm;
+    case kParamNormThresholdDb: return fNormThresholdDb;
+    case kParamSwapFadeMs: return fSwapFadeMs;
+    case kParamInterpolation: return fInterpolation;
+#if GRIST_LIVE_INPUT
+    case kParamFreeze: return fFreeze;
+    case kParamDrone: return fDrone;
+#endif
+    case kParamStreamMisses: return fStreamMisses;
+    default: return 0.0f;
+    }
+}
+
+void Grist::setParameterValue(uint32_t index, float value)
+{
+    switch (index)
+    {
+    case kParamGain:
+        fGain = fclampf(value, 0.0f, 1.0f);
+        break;
+    case kParamGrainSizeMs:
+        fGrainSizeMs = fclampf(value, 5.0f, 250.0f);
+        break;
+    case kParamDensity:
+        fDensity = fclampf(value, 1.0f, 80.0f);
+        break;
+    case kParamPosition:
         fPosition = fclampf(value / 100.0f, 0.0f, 1.0f);
         break;
     case kParamSpray:
@@ -402,6 +1113,32 @@ void Grist::setParameterValue(uint32_t index, float value)
     case kParamNewVoiceOnRetrig:
         fNewVoiceOnRetrig = (value >= 0.5f) ? 1.0f : 0.0f;
         break;
+    case kParamWindowShape:
+        fWindowShape = std::floor(fclampf(value, 0.0f, (float)(kWindowShapeCount - 1)) + 0.5f);
+        break;
+    case kParamSpawnMode:
+        fSpawnMode = std::floor(fclampf(value, 0.0f, (float)(kSpawnModeCount - 1)) + 0.5f);
+        break;
+    case kParamLoudnessNorm:
+        fLoudnessNorm = (value >= 0.5f) ? 1.0f : 0.0f;
+        break;
+    case kParamNormThresholdDb:
+        fNormThresholdDb = fclampf(value, -96.0f, 0.0f);
+        break;
+    case kParamSwapFadeMs:
+        fSwapFadeMs = fclampf(value, 0.0f, 1000.0f);
+        break;
+    case kParamInterpolation:
+        fInterpolation = std::floor(fclampf(value, 0.0f, (float)(kInterpModeCount - 1)) + 0.5f);
+        break;
+#if GRIST_LIVE_INPUT
+    case kParamFreeze:
+        fFreeze = (value >= 0.5f) ? 1.0f : 0.0f;
+        break;
+    case kParamDrone:
+        fDrone = (value >= 0.5f) ? 1.0f : 0.0f;
+        break;
+#endif
     }
 }
 
@@ -410,6 +1147,79 @@ double Grist::midiNoteToHz(int note) const
     return 440.0 * std::pow(2.0, (note - 69) / 12.0);
 }
 
+#if GRIST_LIVE_INPUT
+bool Grist::createCaptureBuffer()
+{
+    const uint32_t rate = (uint32_t)std::lround(targetRate.load());
+    const uint32_t frames = std::max<uint32_t>(1024u, (uint32_t)(captureSeconds.load() * (float)rate));
+
+    std::shared_ptr<SampleData> s(new SampleData());
+    try
+    {
+        s->storageL.assign((size_t)frames * 4, 0.0f); // two copies of interleaved stereo
+    }
+    catch (const std::bad_alloc&)
+    {
+        lastSampleError = "Out of memory for the capture buffer";
+        return false;
+    }
+
+    s->capture = s->storageL.data();
+    s->captureFrames = frames;
+    s->L = s->capture;
+    s->R = s->capture + 1;
+    s->stride = 2;
+    s->frames = (size_t)frames * 2;
+    s->channels = 2;
+    s->sampleRate = rate;
+    s->format = kSampleFloat32;
+
+    lockSampleMemory(*s);
+    publishSample(s);
+    return true;
+}
+
+void Grist::captureInput(const SampleData& s, const float* inL, const float* inR, uint32_t frames)
+{
+    // a new ring starts empty
+    if (captureTarget != &s)
+    {
+        captureTarget = &s;
+        captureHead = 0;
+        captureFilled = 0;
+    }
+
+    if (fFreeze < 0.5f)
+        captureRingWrite(s.capture, s.captureFrames, captureHead, captureFilled, inL, inR, frames);
+}
+
+void Grist::updateDrone()
+{
+    static constexpr int kDroneNote = 60; // plays the input at its own pitch
+
+    const bool held = droneVoice >= 0 && voices[droneVoice].gate && voices[droneVoice].note == kDroneNote;
+    if (fDrone >= 0.5f && !held)
+    {
+        MidiEvent on = {};
+        on.size = 3;
+        on.data[0] = 0x90;
+        on.data[1] = kDroneNote;
+        on.data[2] = 127;
+        handleMidiEvent(on);
+        droneVoice = findVoiceForNote(kDroneNote);
+    }
+    else if (fDrone < 0.5f && held)
+    {
+        MidiEvent off = {};
+        off.size = 3;
+        off.data[0] = 0x80;
+        off.data[1] = kDroneNote;
+        handleMidiEvent(off);
+        droneVoice = -1;
+    }
+}
+#endif
+
 bool Grist::loadDefaultSample()
 {
     const char* home = std::getenv("HOME");
@@ -427,6 +1237,25 @@ bool Grist::loadWavFile(const char* path)
         return false;
     }
 
+    // another instance may already hold this file, loaded with the same options
+    const uint32_t hostRate = (uint32_t)std::lround(targetRate.load());
+    const SampleFormat format = (SampleFormat)sampleFormat.load();
+    const bool mipmaps = mipmapsOn.load();
+    const std::string cacheKey = sampleCacheKey(path, resampleOnLoad.load() ? hostRate : 0, (uint32_t)format, mipmaps ? 1 : 0);
+    if (const std::shared_ptr<const SampleData> shared = SampleCache::instance().find(cacheKey))
+    {
+        lockSampleMemory(*shared);
+        publishSample(shared);
+        return true;
+    }
+
+    // decoded by an earlier session: map it, no parsing or conversion
+    if (diskCacheOn.load() && mapDiskCachedSample(path, cacheKey))
+    {
+        SampleCache::instance().insert(cacheKey, loaderSample);
+        return true;
+    }
+
     drwav wav;
     if (!drwav_init_file(&wav, path, nullptr))
     {
@@ -450,9 +1279,66 @@ bool Grist::loadWavFile(const char* path)
         return false;
     }
 
+    // grain kernels index in-memory sources with 32-bit lanes
+    const bool indexable = frames < 0x7FFFFFFFu;
+
+    // bring in-memory sources to the host rate so grains play at unit increment
+    const bool resample = resampleOnLoad.load() && hostRate != 0 && hostRate != sr;
+
+    // float32 data is used in place: no decode, no copies, page cache shared across instances
+    // (unless a 16-bit format was asked for, which is smaller still)
+    const bool littleEndian = (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__);
+    if (indexable && !resample && format == kSampleFloat32 && littleEndian && wav.translatedFormatTag == DR_WAVE_FORMAT_IEEE_FLOAT
+        && wav.bitsPerSample == 32 && (wav.dataChunkDataPos % sizeof(float)) == 0)
+    {
+        if (mapFloatWavFile(path, ch, sr, frames, wav.dataChunkDataPos))
+        {
+            drwav_uninit(&wav);
+            SampleCache::instance().insert(cacheKey, loaderSample);
+            return true;
+        }
+        // mapping failed (e.g. no mmap on this platform): decode below
+    }
+
+    // not mappable and over the stream budget once decoded: play it from disk instead
+    const size_t cacheBytes = (size_t)streamCacheMb.load() << 20;
+    if (cacheBytes != 0 && frames * ch * sizeof(float) > cacheBytes)
+    {
+        drwav_uninit(&wav);
+        return openStreamedFile(path, cacheBytes);
+    }
+
+    if (!indexable)
+    {
+        drwav_uninit(&wav);
+        lastSampleError = "File too long";
+        return false;
+    }
+
+    // Decode in chunks so progress can be reported and a newer request can cancel us.
     std::vector<float> interleaved;
     interleaved.resize((size_t)frames * ch);
-    const uint64_t read = drwav_read_pcm_frames_f32(&wav, frames, interleaved.data());
+
+    const uint64_t chunkFrames = 1u << 18;
+    uint64_t read = 0;
+    int lastPercent = 0;
+    while (read < frames)
+    {
+        if (loadCancelled())
+        {
+            drwav_uninit(&wav);
+            lastSampleError = "Cancelled";
+            return false;
+        }
+
+        const uint64_t want = std::min<uint64_t>(chunkFrames, frames - read);
+        const uint64_t got = drwav_read_pcm_frames_f32(&wav, want, interleaved.data() + (size_t)read * ch);
+        read += got;
+        if (got < want)
+            break;
+
+        reportLoadProgress(read, resample ? frames * 2 : frames, lastPercent);
+    }
     drwav_uninit(&wav);
     if (read == 0)
     {
@@ -461,331 +1347,848 @@ bool Grist::loadWavFile(const char* path)
     }
 
     std::shared_ptr<SampleData> s(new SampleData());
-    s->L.resize((size_t)read);
-    s->R.resize((size_t)read);
+    s->channels = ch;
     s->sampleRate = sr;
     s->path = path ? path : "";
 
     if (ch == 1)
     {
+        // mono is stored once
+        interleaved.resize((size_t)read);
+        s->storageL.swap(interleaved);
+    }
+    else
+    {
+        s->storageL.resize((size_t)read);
+        s->storageR.resize((size_t)read);
         for (uint64_t i = 0; i < read; ++i)
         {
-            const float v = interleaved[(size_t)i];
-            s->L[(size_t)i] = v;
-            s->R[(size_t)i] = v;
+            s->storageL[(size_t)i] = interleaved[(size_t)i * 2 + 0];
+            s->storageR[(size_t)i] = interleaved[(size_t)i * 2 + 1];
         }
     }
+
+    interleaved.clear();
+    interleaved.shrink_to_fit();
+
+    if (resample && !resampleStorage(*s, hostRate, lastPercent))
+        return false;
+
+    if (mipmaps && !buildMipLevels(*s))
+        return false;
+
+    s->stride = 1;
+    s->frames = s->storageL.size();
+    if (format != kSampleFloat32)
+    {
+        packStorage(*s, format);
+        s->L = s->packedL.data();
+        s->R = (ch == 2) ? s->packedR.data() : s->L;
+        bindMipLevels(*s, s->mipPacked.data(), s->mipCount);
+    }
     else
     {
-        for (uint64_t i = 0; i < read; ++i)
+        s->L = s->storageL.data();
+        s->R = (ch == 2) ? s->storageR.data() : s->L;
+        bindMipLevels(*s, s->mipStorage.data(), s->mipCount);
+    }
+
+    lockSampleMemory(*s);
+    publishSample(s);
+    SampleCache::instance().insert(cacheKey, s);
+
+    if (diskCacheOn.load())
+        writeSampleDiskCache(cacheKey, ch, s->sampleRate, s->format, s->frames, s->L, s->R,
+                             s->mipCount != 0 ? s->mips[0].L : nullptr, s->mipCount);
+
+    return true;
+}
+
+bool Grist::resampleStorage(SampleData& s, uint32_t outRate, int& lastPercent)
+{
+    const PolyphaseResampler rs((double)s.sampleRate, (double)outRate);
+    const size_t inFrames = s.storageL.size();
+    const size_t outFrames = rs.outputLength(inFrames);
+
+    std::vector<float> outL(outFrames);
+    const bool stereo = (s.channels == 2);
+    std::vector<float> outR(stereo ? outFrames : 0);
+
+    // chunked so progress is reported (second half of the bar) and a newer request can cancel us
+    const size_t chunkFrames = 1u << 16;
+    for (size_t pos = 0; pos < outFrames; pos += chunkFrames)
+    {
+        if (loadCancelled())
+        {
+            lastSampleError = "Cancelled";
+            return false;
+        }
+
+        const size_t end = std::min(outFrames, pos + chunkFrames);
+        rs.process(s.storageL.data(), inFrames, outL.data() + pos, pos, end);
+        if (stereo)
+            rs.process(s.storageR.data(), inFrames, outR.data() + pos, pos, end);
+
+        reportLoadProgress((uint64_t)outFrames + end, (uint64_t)outFrames * 2, lastPercent);
+    }
+
+    s.storageL.swap(outL);
+    s.storageR.swap(outR);
+    s.sampleRate = outRate;
+    return true;
+}
+
+bool Grist::buildMipLevels(SampleData& s)
+{
+    const size_t frames = s.storageL.size();
+    const uint32_t ch = s.channels;
+    s.mipCount = mipLevelCount(frames);
+    s.mipStorage.resize(mipBlockElements(frames, ch, s.mipCount));
+
+    const HalfBandDecimator decimator;
+    const float* srcL = s.storageL.data();
+    const float* srcR = s.storageR.data();
+    size_t srcFrames = frames;
+    float* dst = s.mipStorage.data();
+
+    for (uint32_t k = 0; k < s.mipCount; ++k)
+    {
+        const size_t n = mipFrames(srcFrames);
+        float* const dstL = dst;
+        float* const dstR = dst + n;
+
+        // chunked so a newer request can cancel us
+        const size_t chunkFrames = 1u << 16;
+        for (size_t pos = 0; pos < n; pos += chunkFrames)
         {
-            s->L[(size_t)i] = interleaved[(size_t)i * 2 + 0];
-            s->R[(size_t)i] = interleaved[(size_t)i * 2 + 1];
+            if (loadCancelled())
+            {
+                lastSampleError = "Cancelled";
+                return false;
+            }
+            const size_t end = std::min(n, pos + chunkFrames);
+            decimator.process(srcL, srcFrames, dstL + pos, pos, end);
+            if (ch == 2)
+                decimator.process(srcR, srcFrames, dstR + pos, pos, end);
         }
+
+        srcL = dstL;
+        srcR = dstR;
+        srcFrames = n;
+        dst += n * ch;
     }
+    return true;
+}
+
+void Grist::bindMipLevels(SampleData& s, const void* block, uint32_t count)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(block);
+    const size_t bytes = sampleFormatBytes(s.format);
+    size_t frames = s.frames;
 
+    s.mipCount = count;
+    for (uint32_t k = 0; k < count; ++k)
     {
-        const std::lock_guard<std::mutex> lock(sampleMutex);
-        sample = s;
+        frames = mipFrames(frames);
+        SampleData::MipLevel& m = s.mips[k];
+        m.L = p;
+        m.R = (s.channels == 2) ? p + frames * bytes : p;
+        m.frames = frames;
+        p += frames * s.channels * bytes;
     }
+}
+
+void Grist::packStorage(SampleData& s, SampleFormat format)
+{
+    s.packedL.resize(s.storageL.size());
+    packSamples(format, s.storageL.data(), s.storageL.size(), s.packedL.data());
+    s.packedR.resize(s.storageR.size());
+    packSamples(format, s.storageR.data(), s.storageR.size(), s.packedR.data());
+    s.mipPacked.resize(s.mipStorage.size());
+    packSamples(format, s.mipStorage.data(), s.mipStorage.size(), s.mipPacked.data());
+    s.format = format;
+
+    // the float copy is no longer needed
+    std::vector<float>().swap(s.storageL);
+    std::vector<float>().swap(s.storageR);
+    std::vector<float>().swap(s.mipStorage);
+}
+
+bool Grist::mapFloatWavFile(const char* path, uint32_t channels, uint32_t sampleRate,
+                            uint64_t frames, uint64_t dataOffset)
+{
+    std::shared_ptr<SampleData> s(new SampleData());
+    if (!s->map.open(path))
+        return false;
+
+    // trust the file size over the chunk header (truncated renders are common)
+    const size_t frameBytes = sizeof(float) * channels;
+    if (dataOffset >= s->map.size())
+        return false;
+    frames = std::min<uint64_t>(frames, (s->map.size() - (size_t)dataOffset) / frameBytes);
+    if (frames < 2)
+        return false;
 
+    const float* const base = reinterpret_cast<const float*>(s->map.data() + dataOffset);
+    s->L = base;
+    s->R = (channels == 2) ? base + 1 : base;
+    s->stride = channels;
+    s->channels = channels;
+    s->frames = (size_t)frames;
+    s->sampleRate = sampleRate;
+    s->path = path;
+    s->mapDataOffset = (size_t)dataOffset;
+
+    // grains read short runs at scattered positions; prefetchMappedSample() covers the spawn range
+    s->map.adviseRandom();
+
+    lockSampleMemory(*s);
+    publishSample(s);
     return true;
 }
 
-void Grist::run(const float** /*inputs*/, float** outputs, uint32_t frames,
-                const MidiEvent* midiEvents, uint32_t midiEventCount)
+bool Grist::mapDiskCachedSample(const char* path, const std::string& cacheKey)
 {
-    float* outL = outputs[0];
-    float* outR = outputs[1];
+    std::shared_ptr<SampleData> s(new SampleData());
+    SampleDiskCacheHeader hdr;
+    if (!openSampleDiskCache(cacheKey, s->map, hdr))
+        return false;
 
-    for (uint32_t i = 0; i < frames; ++i) { outL[i] = 0.0f; outR[i] = 0.0f; }
+    const uint8_t* const base = s->map.data() + hdr.dataOffset;
+    s->format = (SampleFormat)hdr.format;
+    s->L = base;
+    s->R = (hdr.channels == 2) ? base + (size_t)hdr.frames * sampleFormatBytes(s->format) : base;
+    s->stride = 1;
+    s->channels = hdr.channels;
+    s->frames = (size_t)hdr.frames;
+    s->sampleRate = hdr.sampleRate;
+    s->path = path;
+    s->mapDataOffset = (size_t)hdr.dataOffset;
+    s->diskCached = true;
+    bindMipLevels(*s, base + (size_t)hdr.frames * hdr.channels * sampleFormatBytes(s->format), hdr.mipCount);
+
+    s->map.adviseRandom();
+
+    lockSampleMemory(*s);
+    publishSample(s);
+    return true;
+}
 
-    // Grab sample snapshot (shared_ptr keeps data alive without holding lock)
-    std::shared_ptr<const SampleData> s;
+bool Grist::openStreamedFile(const char* path, size_t cacheBytes)
+{
+    // streams ignore the load options; the first instance's cache size is the one shared
+    std::string cacheKey = sampleCacheKey(path, 0, 0, 0);
+    if (!cacheKey.empty())
+        cacheKey += "|stream";
+    if (const std::shared_ptr<const SampleData> shared = SampleCache::instance().find(cacheKey))
     {
-        std::lock_guard<std::mutex> lock(sampleMutex);
-        s = sample;
+        lockSampleMemory(*shared);
+        publishSample(shared);
+        return true;
     }
-    if (!s || s->L.empty() || s->R.empty())
-        return;
 
-    const size_t len = s->L.size();
-    if (len < 2 || s->sampleRate == 0)
-        return;
+    std::shared_ptr<SampleData> s(new SampleData());
+    s->stream.reset(new SampleStream(path, cacheBytes));
+    if (!s->stream->isOpen())
+    {
+        lastSampleError = "Unable to open/decode WAV";
+        return false;
+    }
 
-    // --- MIDI -> voice allocation ---
-    // Policy: optionally re-use voice if same note is already active, else steal first inactive, else steal quietest.
-    auto findVoiceForNote = [&](int note) -> int {
-        for (uint32_t v = 0; v < kMaxVoices; ++v)
-            if (voices[v].active && voices[v].note == note)
-                return (int)v;
-        return -1;
-    };
+    s->frames = (size_t)s->stream->frameCount();
+    s->channels = s->stream->channelCount();
+    s->sampleRate = s->stream->sampleRate();
+    s->path = path;
 
-    auto removeVoiceFromQueues = [&](int v) {
-        for (uint32_t n = 0; n < 128; ++n)
-            noteQueues[n].remove(v);
-    };
+    lockSampleMemory(*s);
+    publishSample(s);
+    SampleCache::instance().insert(cacheKey, s);
+    return true;
+}
 
-    auto allocVoice = [&]() -> int {
-        for (uint32_t v = 0; v < kMaxVoices; ++v)
-            if (!voices[v].active)
-                return (int)v;
-        // steal the quietest envelope
-        uint32_t best = 0;
-        float bestEnv = voices[0].env;
-        for (uint32_t v = 1; v < kMaxVoices; ++v)
-        {
-            if (voices[v].env < bestEnv)
-            {
-                bestEnv = voices[v].env;
-                best = v;
-            }
+int Grist::findVoiceForNote(int note) const
+{
+    for (uint32_t v = 0; v < kMaxVoices; ++v)
+        if (voices[v].active && voices[v].note == note)
+            return (int)v;
+    return -1;
+}
+
+void Grist::removeVoiceFromQueues(int v)
+{
+    for (uint32_t n = 0; n < 128; ++n)
+        noteQueues[n].remove(v);
+}
+
+int Grist::allocVoice() const
+{
+    for (uint32_t v = 0; v < kMaxVoices; ++v)
+        if (!voices[v].active)
+            return (int)v;
+    // steal the quietest envelope
+    uint32_t best = 0;
+    float bestEnv = voices[0].env;
+    for (uint32_t v = 1; v < kMaxVoices; ++v)
+    {
+        if (voices[v].env < bestEnv)
+        {
+            bestEnv = voices[v].env;
+            best = v;
+        }
+    }
+    return (int)best;
+}
+
+void Grist::handleMidiEvent(const MidiEvent& ev)
+{
+    // Policy: optionally re-use voice if same note is already active, else steal first inactive, else steal quietest.
+    if (ev.size < 3) return;
+    const uint8_t st = ev.data[0] & 0xF0;
+    const int note = (int)(ev.data[1] & 0x7F);
+    const uint8_t vel = ev.data[2] & 0x7F;
+    const bool isNoteOn  = (st == 0x90) && (vel > 0);
+    const bool isNoteOff = (st == 0x80) || ((st == 0x90) && (vel == 0));
+
+    if (isNoteOn)
+    {
+        int v = -1;
+        if (fNewVoiceOnRetrig < 0.5f)
+            v = findVoiceForNote(note);
+        if (v < 0) v = allocVoice();
+
+        // If we're stealing/reusing a voice, ensure it isn't still referenced by any note queue.
+        removeVoiceFromQueues(v);
+
+        Voice& voice = voices[(uint32_t)v];
+        voice.active = true;
+        voice.gate = true;
+        voice.releasing = false;
+        voice.note = note;
+        voice.velocity = (float)vel / 127.0f;
+        voice.env = 0.0f; // attack ramp
+        voice.pitchEnv = fPitchEnvAmt;
+        voice.samplesToNextGrain = 0.0;
+
+        // optionally kill old grains in this voice on retrigger
+        if (fKillOnRetrig >= 0.5f)
+        {
+            grains.releaseVoice((uint32_t)v);
+            fadingGrains.releaseVoice((uint32_t)v);
         }
-        return (int)best;
-    };
 
-    for (uint32_t i = 0; i < midiEventCount; ++i)
-    {
-        const MidiEvent& ev = midiEvents[i];
-        if (ev.size < 3) continue;
-        const uint8_t st = ev.data[0] & 0xF0;
-        const int note = (int)(ev.data[1] & 0x7F);
-        const uint8_t vel = ev.data[2] & 0x7F;
-        const bool isNoteOn  = (st == 0x90) && (vel > 0);
-        const bool isNoteOff = (st == 0x80) || ((st == 0x90) && (vel == 0));
-
-        if (isNoteOn)
-        {
-            int v = -1;
-            if (fNewVoiceOnRetrig < 0.5f)
-                v = findVoiceForNote(note);
-            if (v < 0) v = allocVoice();
-
-            // If we're stealing/reusing a voice, ensure it isn't still referenced by any note queue.
-            removeVoiceFromQueues(v);
-
-            Voice& voice = voices[(uint32_t)v];
-            voice.active = true;
-            voice.gate = true;
-            voice.releasing = false;
-            voice.note = note;
-            voice.velocity = (float)vel / 127.0f;
-            voice.env = 0.0f; // attack ramp
-            voice.pitchEnv = fPitchEnvAmt;
-            voice.samplesToNextGrain = 0.0;
-
-            // optionally kill old grains in this voice on retrigger
-            if (fKillOnRetrig >= 0.5f)
+        // Track this note-on so a later note-off can release the matching event.
+        noteQueues[(uint32_t)note].push(v);
+    }
+    else if (isNoteOff)
+    {
+        int v = -1;
+        if (noteQueues[(uint32_t)note].pop(v))
+        {
+            if (v >= 0 && v < (int)kMaxVoices)
             {
-                for (uint32_t g = 0; g < Voice::kMaxGrains; ++g)
-                    voice.grains[g].active = false;
+                Voice& voice = voices[(uint32_t)v];
+                voice.gate = false;
+                voice.releasing = true;
             }
-
-            // Track this note-on so a later note-off can release the matching event.
-            noteQueues[(uint32_t)note].push(v);
         }
-        else if (isNoteOff)
+        else
         {
-            int v = -1;
-            if (noteQueues[(uint32_t)note].pop(v))
+            // fallback: release any currently-playing voice for this note
+            v = findVoiceForNote(note);
+            if (v >= 0)
             {
-                if (v >= 0 && v < (int)kMaxVoices)
-                {
-                    Voice& voice = voices[(uint32_t)v];
-                    voice.gate = false;
-                    voice.releasing = true;
-                }
+                Voice& voice = voices[(uint32_t)v];
+                voice.gate = false;
+                voice.releasing = true;
             }
-            else
+        }
+    }
+}
+
+GrainKernelFn Grist::bindGrainKernel(const SampleData& s, GrainInterp interp, GrainKernelArgs& ka, GrainPhase* lastPos) const
+{
+    // mip level k: grains whose increment is at least 2^k (levels past mipCount are never picked)
+    for (uint32_t k = 0; k < kGrainMipLevels; ++k)
+    {
+        const bool mip = k > 0 && k <= s.mipCount;
+        ka.L[k] = mip ? s.mips[k - 1].L : s.L;
+        ka.R[k] = mip ? s.mips[k - 1].R : s.R;
+        ka.len[k] = mip ? s.mips[k - 1].frames : s.frames;
+        lastPos[k] = grainPhaseFromIndex(ka.len[k] - 1);
+    }
+    ka.stride = s.stride;
+    ka.stream = s.stream.get();
+    ka.sinc = &GrainSincTables::instance();
+
+    return s.stream ? selectStreamedGrainKernel(interp, s.channels)
+                    : grainKernels.select(interp, s.format, s.channels);
+}
+
+// Frames, out of the next `frames`, before a grain reaches its duration or the end of its source.
+static inline uint32_t grainLiveFrames(const GrainPool& pool, uint32_t g, const GrainPhase* lastPos, uint32_t frames)
+{
+    const GrainPhase pos = pool.pos[g];
+    const GrainPhase last = lastPos[pool.level[g]];
+    if (pool.age[g] >= pool.dur[g] || pos >= last)
+        return 0;
+
+    uint32_t live = std::min(frames, pool.dur[g] - pool.age[g]);
+    const GrainPhase inc = pool.inc[g];
+    if (inc > 0)
+        live = (uint32_t)std::min<uint64_t>(live, (last - pos + inc - 1) / inc);
+    return live;
+}
+
+// One frame of the per-note pitch envelope (decays toward 0 semitones).
+static inline float stepPitchEnv(float p, float step)
+{
+    return p > 0.0f ? std::max(0.0f, p - step) : std::min(0.0f, p + step);
+}
+
+// Lays out the grain onsets of frames [begin, end) of the current renderFrames() call and
+// advances each voice's schedule past them. Onsets keep their fractional time: a grain is
+// spawned on the first frame at or after its onset, already `lead` frames into its playback.
+void Grist::buildSpawnTimeline(const BlockParams& bp, uint32_t begin, uint32_t end)
+{
+    const double span = (double)(end - begin);
+    spawnCount = 0;
+
+    if (bp.density > 0.0)
+    {
+        for (uint32_t v = 0; v < kMaxVoices; ++v)
+        {
+            Voice& voice = voices[v];
+            if (!voice.active || !voice.gate)
+                continue;
+
+            // onsets in (span - 1, span) land on the frame after this span; leave them to the next one
+            double t = voice.samplesToNextGrain;
+            while (t <= span - 1.0 && spawnCount < kMaxSpawnEvents)
             {
-                // fallback: release any currently-playing voice for this note
-                v = findVoiceForNote(note);
-                if (v >= 0)
-                {
-                    Voice& voice = voices[(uint32_t)v];
-                    voice.gate = false;
-                    voice.releasing = true;
-                }
+                const double frame = std::ceil(t);
+                spawnTimeline[spawnCount++] = { begin + (uint32_t)frame, v, (float)(frame - t) };
+                t += bp.samplesPerGrain;
             }
+            voice.samplesToNextGrain = t - span;
         }
     }
 
-    // --- shared grain constants ---
-    const double grainDurSec = (double)fGrainSizeMs / 1000.0;
-    const uint32_t grainDur = (uint32_t)std::max(8.0, grainDurSec * (double)s->sampleRate);
+    // voice-major -> frame-major; stable, so same-frame onsets keep voice order
+    for (uint32_t k = 1; k < spawnCount; ++k)
+    {
+        const SpawnEvent e = spawnTimeline[k];
+        uint32_t j = k;
+        for (; j > 0 && spawnTimeline[j - 1].frame > e.frame; --j)
+            spawnTimeline[j] = spawnTimeline[j - 1];
+        spawnTimeline[j] = e;
+    }
+}
 
-    const double density = std::max(0.0, (double)fDensity);
-    const double samplesPerGrain = (density > 0.0) ? (fSampleRate / density) : 1e30;
+void Grist::spawnGrain(const SampleData& s, const BlockParams& bp, uint32_t v, float lead)
+{
+    const int32_t slot = grains.alloc();
+    if (slot < 0)
+        return;
 
-    const uint32_t attackSamples = (uint32_t)std::max(1.0, ((double)fAttackMs / 1000.0) * fSampleRate);
-    const float attackInc = (fAttackMs <= 0.0f) ? 1.0f : (1.0f / (float)attackSamples);
+    const Voice& voice = voices[v];
+    const size_t len = s.frames;
 
-    const uint32_t releaseSamples = (uint32_t)std::max(1.0, ((double)fReleaseMs / 1000.0) * fSampleRate);
-    const float releaseDec = 1.0f / (float)releaseSamples;
+    const float center = fPosition;
+    const float spray = fSpray;
+    const float rr = rngFloat01() * 2.0f - 1.0f; // -1..1
+    float pos01 = fclampf(center + rr * spray, 0.0f, 1.0f);
+    double start01 = (double)pos01;
 
-    // per-note pitch envelope decay (semitones per sample)
-    const uint32_t pitchDecaySamples = (uint32_t)std::max(1.0, ((double)fPitchEnvDecayMs / 1000.0) * fSampleRate);
-    const float pitchStep = (fPitchEnvDecayMs <= 0.0f) ? 1e9f : (std::abs(fPitchEnvAmt) / (float)pitchDecaySamples);
+    // onset index (once analysed): O(log n) per grain
+    bool audible = true;
+    if (bp.analysis != nullptr && bp.spawnMode == kSpawnOnsets)
+    {
+        bp.analysis->nearestOnset(start01, start01);
+    }
+    else if (bp.analysis != nullptr && bp.spawnMode == kSpawnAudible)
+    {
+        const double lo = (double)fclampf(center - spray, 0.0f, 1.0f);
+        const double hi = (double)fclampf(center + spray, 0.0f, 1.0f);
+        audible = bp.analysis->pickAudible(lo, hi, (double)(rr * 0.5f + 0.5f), start01);
+    }
+    pos01 = (float)start01;
+    double start = start01 * (double)(len - 2);
+
+    const double noteMul = midiNoteToHz(voice.note) / midiNoteToHz(60);
+    const double pitchMul = std::pow(2.0, (double)fPitch / 12.0);
+    // spawns precede the envelope step of their frame: use the value that step produces
+    const double pitchEnvMul = std::pow(2.0, (double)stepPitchEnv(voice.pitchEnv, bp.pitchStep) / 12.0);
+    const double baseInc = noteMul * pitchMul * pitchEnvMul * bp.srMul;
+
+    const float rp = fRandomPitch;
+    const float rps = (rngFloat01() * 2.0f - 1.0f) * rp;
+    const double randPitchMul = std::pow(2.0, (double)rps / 12.0);
+
+#if GRIST_LIVE_INPUT
+    // live input: Position is how far back into the captured history the grain ends
+    if (s.capture != nullptr)
+        start = captureGrainStart(s.captureFrames, captureHead, captureFilled, start01,
+                                  baseInc * randPitchMul * (double)bp.grainDur,
+                                  (double)bp.grainDur + (double)getBufferSize());
+#endif
+
+    // an octave or more up: read the matching band-limited half-rate copy
+    uint32_t level = 0;
+    double levelStart = start;
+    double levelInc = baseInc * randPitchMul;
+    while (level < s.mipCount && levelInc >= 2.0)
+    {
+        levelStart *= 0.5;
+        levelInc *= 0.5;
+        ++level;
+    }
 
-    const double twoPi = 6.283185307179586;
+    // loudness-normalised: level the grain by the RMS of the span it will read,
+    // or drop it when that span is below the threshold
+    float loudness = 1.0f;
+    if (audible && bp.analysis != nullptr && bp.loudnessNorm)
+    {
+        const double span01 = baseInc * randPitchMul * (double)bp.grainDur / (double)len;
+        const float ms = bp.analysis->meanSquare(start01, start01 + span01);
+        if (ms < bp.normFloor)
+            audible = false;
+        else
+            loudness = std::min(kMaxLoudnessGain, kLoudnessTarget / std::sqrt(ms));
+    }
 
-    // --- render ---
-    for (uint32_t i = 0; i < frames; ++i)
+    if (!audible)
     {
-        float mixL = 0.0f;
-        float mixR = 0.0f;
+        // nothing worth hearing: leave the slot (and the CPU) to audible grains
+        grains.release((uint32_t)slot);
+        return;
+    }
 
-        for (uint32_t v = 0; v < kMaxVoices; ++v)
+    // sub-sample onset: the grain is `lead` frames in at its first rendered frame
+    const uint32_t g = (uint32_t)slot;
+    grains.pos[g] = grainPhaseFromFrames(levelStart + levelInc * (double)lead);
+    grains.inc[g] = grainPhaseFromFrames(levelInc);
+    grains.interp[g] = bp.interp;
+    if (bp.interp == kInterpAuto)
+    {
+        // per grain from its increment; unit-rate grains start on a whole frame
+        grains.interp[g] = grainInterpForIncrement(grains.inc[g]);
+        if (grains.interp[g] == kInterpLinear)
+            grains.pos[g] = grainPhaseFromIndex(grainPhaseIndex(grains.pos[g]));
+    }
+    grains.startPos[g] = grains.pos[g];
+    grains.level[g] = level;
+    grains.age[g] = 0;
+    grains.dur[g] = bp.grainDur;
+    grains.winInc[g] = GrainWindowTable::stepForDuration(bp.grainDur);
+    grains.winPos[g] = grains.winInc[g] * lead;
+    grains.voice[g] = v;
+
+    // size normalization: keep energy roughly stable as grain size changes
+    const float norm = loudness / std::sqrt(std::max(1.0f, (float)bp.grainDur));
+
+    // simple stereo spread tied to spray (0..1)
+    const float pan = (rngFloat01() * 2.0f - 1.0f) * spray; // -spray..spray
+    const float ang = (pan * 0.5f + 0.5f) * 1.57079632679f; // 0..pi/2
+    grains.gainL[g] = std::cos(ang) * norm;
+    grains.gainR[g] = std::sin(ang) * norm;
+
+    // viz: record normalized start position (best-effort)
+    if (vizEventCount < kVizMaxEvents)
+        vizEvents[vizEventCount++] = pos01;
+}
+
+// Advances every voice's envelopes by `frames` (at most kSpawnTimelineFrames) and fills
+// voiceEnv with each frame's amplitude. Returns a mask of the voices that ended; their
+// amplitude is zero from the frame they ended on, and their grains are still live.
+uint32_t Grist::updateVoiceEnvelopes(const BlockParams& bp, uint32_t frames)
+{
+    uint32_t ended = 0;
+
+    for (uint32_t v = 0; v < kMaxVoices; ++v)
+    {
+        Voice& voice = voices[v];
+        float* const amp = voiceEnv[v];
+        if (!voice.active)
         {
-            Voice& voice = voices[v];
-            if (!voice.active)
-                continue;
+            std::fill(amp, amp + frames, 0.0f);
+            continue;
+        }
 
-            // envelope
+        const float gain = fGain * voice.velocity;
+        for (uint32_t k = 0; k < frames; ++k)
+        {
             if (voice.releasing)
             {
-                voice.env -= releaseDec;
+                voice.env -= bp.releaseDec;
                 if (voice.env <= 0.0f)
                 {
                     voice.env = 0.0f;
                     voice.active = false;
                     voice.releasing = false;
-                    // grains will be ignored once inactive
-                    continue;
+                    ended |= 1u << v;
+                    std::fill(amp + k, amp + frames, 0.0f);
+                    break;
                 }
             }
-            else if (voice.gate)
+            else if (voice.gate && voice.env < 1.0f)
             {
                 // attack (simple linear ramp)
-                if (voice.env < 1.0f)
-                {
-                    voice.env += attackInc;
-                    if (voice.env > 1.0f) voice.env = 1.0f;
-                }
+                voice.env += bp.attackInc;
+                if (voice.env > 1.0f) voice.env = 1.0f;
             }
 
-            // pitch envelope (decays toward 0 semitones)
-            if (voice.pitchEnv > 0.0f)
+            voice.pitchEnv = stepPitchEnv(voice.pitchEnv, bp.pitchStep);
+            amp[k] = gain * voice.env;
+        }
+    }
+
+    return ended;
+}
+
+// Renders `frames` (at most kSpawnTimelineFrames) of a pool: each live grain runs once over
+// the frames it has left, into its voice's bus; the buses are then scaled by voiceEnv and
+// summed into mixL/mixR. Grains that finish are retired. Returns how many leading frames
+// had a live grain (`frames` if one is still playing).
+uint32_t Grist::renderGrainSpan(GrainPool& pool, GrainKernelFn kernel, const GrainKernelArgs& ka,
+                                const GrainPhase* lastPos, uint32_t frames, float* mixL, float* mixR)
+{
+    uint32_t used = 0;
+    uint32_t liveMax = 0;
+    uint32_t kept = 0;
+
+    const uint32_t count = pool.activeCount();
+    for (uint32_t g = 0; g < count; ++g)
+    {
+        const uint32_t live = grainLiveFrames(pool, g, lastPos, frames);
+        if (live > 0)
+        {
+            const uint32_t v = pool.voice[g];
+            if ((used & (1u << v)) == 0)
             {
-                voice.pitchEnv -= pitchStep;
-                if (voice.pitchEnv < 0.0f) voice.pitchEnv = 0.0f;
+                std::fill(voiceBusL[v], voiceBusL[v] + frames, 0.0f);
+                std::fill(voiceBusR[v], voiceBusR[v] + frames, 0.0f);
+                used |= 1u << v;
             }
-            else if (voice.pitchEnv < 0.0f)
+            kernel(pool, g, ka, live, voiceBusL[v], voiceBusR[v]);
+            liveMax = std::max(liveMax, live);
+        }
+
+        // finished grains drop out; the rest keep their order (see GrainPool)
+        if (live == frames)
+        {
+            if (kept != g)
+                pool.move(kept, g);
+            ++kept;
+        }
+    }
+    pool.truncate(kept);
+
+    std::fill(mixL, mixL + frames, 0.0f);
+    std::fill(mixR, mixR + frames, 0.0f);
+    for (uint32_t v = 0; v < kMaxVoices; ++v)
+    {
+        if ((used & (1u << v)) == 0)
+            continue;
+        const float* const amp = voiceEnv[v];
+        const float* const busL = voiceBusL[v];
+        const float* const busR = voiceBusR[v];
+        for (uint32_t k = 0; k < frames; ++k)
+        {
+            mixL[k] += busL[k] * amp[k];
+            mixR[k] += busR[k] * amp[k];
+        }
+    }
+
+    return liveMax;
+}
+
+void Grist::renderFrames(const SampleData& s, const SampleData* fading, const BlockParams& bp,
+                         float* outL, float* outR, uint32_t frames)
+{
+    GrainKernelArgs ka;
+    GrainPhase lastPos[kGrainMipLevels];
+    const GrainKernelFn kernel = bindGrainKernel(s, bp.interp, ka, lastPos);
+    ka.window = bp.window;
+
+    // replaced sample, still read by fadingGrains until the swap crossfade ends
+    GrainKernelArgs fadeKa;
+    GrainPhase fadeLastPos[kGrainMipLevels];
+    GrainKernelFn fadeKernel = nullptr;
+    if (fading != nullptr)
+    {
+        fadeKernel = bindGrainKernel(*fading, bp.interp, fadeKa, fadeLastPos);
+        fadeKa.window = bp.window;
+    }
+
+    uint32_t timelineEnd = 0;
+    uint32_t nextSpawn = 0;
+
+    // grain-major: between two spawn events the set of grains is fixed, so each span
+    // renders grain by grain and applies the voice envelopes once per span
+    for (uint32_t i = 0; i < frames;)
+    {
+        if (i == timelineEnd)
+        {
+            timelineEnd = std::min(frames, i + kSpawnTimelineFrames);
+            buildSpawnTimeline(bp, i, timelineEnd);
+            nextSpawn = 0;
+        }
+
+        // grains whose onset falls in this frame (only gated voices are scheduled)
+        for (; nextSpawn < spawnCount && spawnTimeline[nextSpawn].frame == i; ++nextSpawn)
+            spawnGrain(s, bp, spawnTimeline[nextSpawn].voice, spawnTimeline[nextSpawn].lead);
+
+        const uint32_t end = nextSpawn < spawnCount ? spawnTimeline[nextSpawn].frame : timelineEnd;
+        const uint32_t n = end - i;
+
+        const uint32_t ended = updateVoiceEnvelopes(bp, n);
+        renderGrainSpan(grains, kernel, ka, lastPos, n, outL + i, outR + i);
+
+        // swap crossfade: old grains fade out linearly. New grains are not faded in (their
+        // windows already start at zero), so the fade may end early without a gain jump.
+        if (fadeKernel != nullptr && fadeRemaining > 0)
+        {
+            const uint32_t fadeN = std::min(n, fadeRemaining);
+            const uint32_t oldLive = renderGrainSpan(fadingGrains, fadeKernel, fadeKa, fadeLastPos, fadeN, fadeMixL, fadeMixR);
+            for (uint32_t k = 0; k < oldLive; ++k)
             {
-                voice.pitchEnv += pitchStep;
-                if (voice.pitchEnv > 0.0f) voice.pitchEnv = 0.0f;
+                const float g = (float)fadeRemaining / (float)fadeLength;
+                outL[i + k] += fadeMixL[k] * g;
+                outR[i + k] += fadeMixR[k] * g;
+                --fadeRemaining;
             }
+            if (oldLive < fadeN)
+                fadeRemaining = 0; // the old grains all ended early
+        }
 
-            // spawn grains (only while gate held)
-            if (voice.gate && density > 0.0)
+        for (uint32_t v = 0; v < kMaxVoices; ++v)
+        {
+            if ((ended & (1u << v)) != 0)
             {
-                voice.samplesToNextGrain -= 1.0;
-                while (voice.samplesToNextGrain <= 0.0)
-                {
-                    // find slot
-                    int slot = -1;
-                    for (uint32_t gi = 0; gi < Voice::kMaxGrains; ++gi)
-                        if (!voice.grains[gi].active) { slot = (int)gi; break; }
-
-                    if (slot >= 0)
-                    {
-                        const float center = fPosition;
-                        const float spray = fSpray;
-                        const float rr = rngFloat01() * 2.0f - 1.0f; // -1..1
-                        const float pos01 = fclampf(center + rr * spray, 0.0f, 1.0f);
-                        const double start = (double)pos01 * (double)(len - 2);
-
-                        const double noteMul = midiNoteToHz(voice.note) / midiNoteToHz(60);
-                        const double pitchMul = std::pow(2.0, (double)fPitch / 12.0);
-                        const double srMul = (double)s->sampleRate / fSampleRate;
-                        const double pitchEnvMul = std::pow(2.0, (double)voice.pitchEnv / 12.0);
-                        const double baseInc = noteMul * pitchMul * pitchEnvMul * srMul;
-
-                        const float rp = fRandomPitch;
-                        const float rps = (rngFloat01() * 2.0f - 1.0f) * rp;
-                        const double randPitchMul = std::pow(2.0, (double)rps / 12.0);
-
-                        Grain& g = voice.grains[(uint32_t)slot];
-                        g.active = true;
-                        g.pos = start;
-                        g.startPos = start;
-                        g.inc = baseInc * randPitchMul;
-                        g.age = 0;
-                        g.dur = grainDur;
-
-                        // simple stereo spread tied to spray (0..1)
-                        const float pan = (rngFloat01() * 2.0f - 1.0f) * spray; // -spray..spray
-                        const float ang = (pan * 0.5f + 0.5f) * 1.57079632679f; // 0..pi/2
-                        g.panL = std::cos(ang);
-                        g.panR = std::sin(ang);
-
-                        // viz: record normalized start position (best-effort)
-                        if (vizEventCount < kVizMaxEvents)
-                            vizEvents[vizEventCount++] = pos01;
-                    }
-
-                    voice.samplesToNextGrain += samplesPerGrain;
-                    if (voice.samplesToNextGrain > samplesPerGrain)
-                        break;
-                }
+                grains.releaseVoice(v);
+                fadingGrains.releaseVoice(v);
             }
+        }
 
-            float accL = 0.0f;
-            float accR = 0.0f;
+        i = end;
+    }
+}
 
-            // render grains
-            for (uint32_t gi = 0; gi < Voice::kMaxGrains; ++gi)
-            {
-                Grain& g = voice.grains[gi];
-                if (!g.active) continue;
+void Grist::run(const float** inputs, float** outputs, uint32_t frames,
+                const MidiEvent* midiEvents, uint32_t midiEventCount)
+{
+    float* outL = outputs[0];
+    float* outR = outputs[1];
 
-                if (g.age >= g.dur)
-                {
-                    g.active = false;
-                    continue;
-                }
+    // Current sample (wait-free; a replaced sample is reclaimed by the loader thread)
+    const uint32_t fadeFrames = (uint32_t)((double)fSwapFadeMs / 1000.0 * fSampleRate);
+    const SampleData* const s = acquireSample(fadeFrames);
 
-                const size_t idx = (size_t)g.pos;
-                if (idx + 1 >= len)
-                {
-                    g.active = false;
-                    continue;
-                }
+#if GRIST_LIVE_INPUT
+    // before the outputs are cleared: hosts may process in place
+    if (s != nullptr && s->capture != nullptr)
+        captureInput(*s, inputs[0], inputs[1], frames);
+    updateDrone();
+#else
+    (void)inputs;
+#endif
 
-                const float frac = (float)(g.pos - (double)idx);
+    for (uint32_t i = 0; i < frames; ++i) { outL[i] = 0.0f; outR[i] = 0.0f; }
 
-                // cubic interpolation (Catmull-Rom)
-                const size_t i0 = (idx > 0) ? (idx - 1) : idx;
-                const size_t i1 = idx;
-                const size_t i2 = (idx + 1 < len) ? (idx + 1) : idx;
-                const size_t i3 = (idx + 2 < len) ? (idx + 2) : i2;
+    if (!s || s->frames == 0)
+        return;
+    const SampleData* const fading = (fadingSample != nullptr) ? fadingSample->data.get() : nullptr;
 
-                const float l = catmullRom(s->L[i0], s->L[i1], s->L[i2], s->L[i3], frac);
-                const float r = catmullRom(s->R[i0], s->R[i1], s->R[i2], s->R[i3], frac);
+    const size_t len = s->frames;
+    if (len < 2 || s->sampleRate == 0)
+        return;
 
-                const double phase = (g.dur > 1) ? ((double)g.age / (double)(g.dur - 1)) : 1.0;
-                const float w = (float)(0.5 - 0.5 * std::cos(twoPi * phase));
+    // --- shared grain constants ---
+    BlockParams bp;
 
-                // size normalization: keep energy roughly stable as grain size changes
-                const float norm = 1.0f / std::sqrt(std::max(1.0f, (float)g.dur));
+    const double grainDurSec = (double)fGrainSizeMs / 1000.0;
+    bp.grainDur = (uint32_t)std::max(8.0, grainDurSec * fSampleRate); // output samples
 
-                accL += l * w * norm * g.panL;
-                accR += r * w * norm * g.panR;
+    bp.density = std::max(0.0, (double)fDensity);
+    bp.samplesPerGrain = (bp.density > 0.0) ? (fSampleRate / bp.density) : 1e30;
 
-                g.pos += g.inc;
-                g.age += 1;
-            }
+    const uint32_t attackSamples = (uint32_t)std::max(1.0, ((double)fAttackMs / 1000.0) * fSampleRate);
+    bp.attackInc = (fAttackMs <= 0.0f) ? 1.0f : (1.0f / (float)attackSamples);
+
+    const uint32_t releaseSamples = (uint32_t)std::max(1.0, ((double)fReleaseMs / 1000.0) * fSampleRate);
+    bp.releaseDec = 1.0f / (float)releaseSamples;
 
-            const float vAmp = fGain * voice.velocity * voice.env;
-            mixL += accL * vAmp;
-            mixR += accR * vAmp;
+    // per-note pitch envelope decay (semitones per sample)
+    const uint32_t pitchDecaySamples = (uint32_t)std::max(1.0, ((double)fPitchEnvDecayMs / 1000.0) * fSampleRate);
+    bp.pitchStep = (fPitchEnvDecayMs <= 0.0f) ? 1e9f : (std::abs(fPitchEnvAmt) / (float)pitchDecaySamples);
+
+    bp.srMul = (double)s->sampleRate / fSampleRate;
+    bp.window = GrainWindowTable::instance().data((uint32_t)fWindowShape);
+    bp.analysis = currentSample->analysis.get();
+    bp.spawnMode = (uint32_t)fSpawnMode;
+    bp.interp = (GrainInterp)(uint32_t)fInterpolation;
+    bp.loudnessNorm = fLoudnessNorm >= 0.5f;
+    bp.normFloor = std::pow(10.0f, fNormThresholdDb / 10.0f);
+
+    // streamed sample being crossfaded out: post the frames its remaining grains will read,
+    // before playingSample (the stream thread drops the old stream once neither names it)
+    if (fading != nullptr && fading->stream && fadingGrains.activeCount() > 0)
+    {
+        double lo = (double)fading->frames, hi = 0.0;
+        for (uint32_t g = 0; g < fadingGrains.activeCount(); ++g)
+        {
+            const double scale = (double)(1u << fadingGrains.level[g]);
+            const double p = grainPhaseToFrames(fadingGrains.pos[g]) * scale;
+            const double left = (double)(fadingGrains.dur[g] - std::min(fadingGrains.age[g], fadingGrains.dur[g]));
+            lo = std::min(lo, p);
+            hi = std::max(hi, p + left * grainPhaseToFrames(fadingGrains.inc[g]) * scale + 1.0);
         }
+        fadePrefetchBegin.store((uint64_t)lo, std::memory_order_relaxed);
+        fadePrefetchEnd.store((uint64_t)std::min(hi, (double)fading->frames), std::memory_order_relaxed);
+        fadePrefetchFor.store(fading, std::memory_order_release);
+    }
+    else
+    {
+        fadePrefetchFor.store(nullptr, std::memory_order_release);
+    }
+
+    // mapped/streamed samples: post which part grains will read (spray range plus the
+    // reach of a grain pitched up two octaves) so it can be made resident ahead of time
+    if (s->map.isOpen() || s->stream)
+    {
+        prefetchLo.store((double)fclampf(fPosition - fSpray, 0.0f, 1.0f), std::memory_order_relaxed);
+        prefetchHi.store((double)fclampf(fPosition + fSpray, 0.0f, 1.0f), std::memory_order_relaxed);
+        prefetchReach.store((double)bp.grainDur / fSampleRate * 4.0, std::memory_order_relaxed);
+    }
+    // after the fade window: a stream named by neither is dropped by the stream thread
+    playingSample.store(s, std::memory_order_release);
+
+    // --- render, split into sub-blocks at MIDI event frames ---
+    // Events are applied exactly at their frame offset; the grain loop itself never checks for events.
+    const bool streamed = s->stream || (fading != nullptr && fading->stream);
+    if (streamed)
+        streamRead.beginRead();
+
+    uint32_t pos = 0;
+    uint32_t ev = 0;
+    while (pos < frames)
+    {
+        while (ev < midiEventCount && midiEvents[ev].frame <= pos)
+            handleMidiEvent(midiEvents[ev++]);
 
-        outL[i] = mixL;
-        outR[i] = mixR;
+        const uint32_t end = (ev < midiEventCount) ? std::min(frames, midiEvents[ev].frame) : frames;
+        renderFrames(*s, fading, bp, outL + pos, outR + pos, end - pos);
+        pos = end;
     }
 
+    if (streamed)
+        streamRead.endRead();
+    fStreamMisses = s->stream ? (float)s->stream->missCount() : 0.0f;
+
+    // events past the end of the block (host bug) still take effect
+    while (ev < midiEventCount)
+        handleMidiEvent(midiEvents[ev++]);
+
     // Publish grain viz to UI at ~30 Hz (best-effort).
     // - grains: comma-separated list of 0..1 floats (spawn markers)
     // - grains_active: semicolon-separated list of "start,end,age,amp,voice" quints
@@ -824,44 +2227,39 @@ void Grist::run(const float** /*inputs*/, float** outputs, uint32_t frames,
         char abuf[1536];
         uint32_t apos = 0;
 
-        for (uint32_t v = 0; v < kMaxVoices && count < kMaxActiveSend; ++v)
+        for (uint32_t g = 0; g < grains.activeCount() && count < kMaxActiveSend; ++g)
         {
+            const uint32_t v = grains.voice[g];
             const Voice& voice = voices[v];
-            if (!voice.active) continue;
-
-            for (uint32_t gi = 0; gi < Voice::kMaxGrains && count < kMaxActiveSend; ++gi)
-            {
-                const Grain& g = voice.grains[gi];
-                if (!g.active) continue;
-
-                const double start = g.startPos;
-                const double span = g.inc * (double)g.dur;
-                const double end = start + span;
 
-                const float start01 = (float)fclampf((float)(start / (double)(len - 1)), 0.0f, 1.0f);
-                const float end01 = (float)fclampf((float)(end / (double)(len - 1)), 0.0f, 1.0f);
-                const float age01 = (g.dur > 0) ? fclampf((float)g.age / (float)g.dur, 0.0f, 1.0f) : 1.0f;
+            // back to full-rate frames
+            const double levelScale = (double)(1u << grains.level[g]);
+            const double start = grainPhaseToFrames(grains.startPos[g]) * levelScale;
+            const double span = grainPhaseToFrames(grains.inc[g]) * (double)grains.dur[g] * levelScale;
+            const double end = start + span;
 
-                // window level at current age (0..1)
-                const double phase = (g.dur > 1) ? ((double)g.age / (double)(g.dur - 1)) : 1.0;
-                const float w = (float)(0.5 - 0.5 * std::cos(twoPi * phase));
-                const float amp01 = fclampf(w * voice.env * voice.velocity, 0.0f, 1.0f);
+            const float start01 = (float)fclampf((float)(start / (double)(len - 1)), 0.0f, 1.0f);
+            const float end01 = (float)fclampf((float)(end / (double)(len - 1)), 0.0f, 1.0f);
+            const float age01 = (grains.dur[g] > 0) ? fclampf((float)grains.age[g] / (float)grains.dur[g], 0.0f, 1.0f) : 1.0f;
 
-                act[count] = { start01, end01, age01, amp01, v };
+            // window level at current age (0..1)
+            const float w = GrainWindowTable::read(bp.window, grains.winPos[g]);
+            const float amp01 = fclampf(w * voice.env * voice.velocity, 0.0f, 1.0f);
 
-                // also encode as string state (best-effort)
-                const int n = std::snprintf(abuf + apos, sizeof(abuf) - apos,
-                                           (count == 0) ? "%.4f,%.4f,%.4f,%.4f,%u" : ";%.4f,%.4f,%.4f,%.4f,%u",
-                                           start01, end01, age01, amp01, v);
-                if (n > 0)
-                {
-                    apos += (uint32_t)n;
-                    if (apos + 24 >= sizeof(abuf))
-                        apos = 0; // give up on string if too big
-                }
+            act[count] = { start01, end01, age01, amp01, v };
 
-                ++count;
+            // also encode as string state (best-effort)
+            const int n = std::snprintf(abuf + apos, sizeof(abuf) - apos,
+                                       (count == 0) ? "%.4f,%.4f,%.4f,%.4f,%u" : ";%.4f,%.4f,%.4f,%.4f,%u",
+                                       start01, end01, age01, amp01, v);
+            if (n > 0)
+            {
+                apos += (uint32_t)n;
+                if (apos + 24 >= sizeof(abuf))
+                    apos = 0; // give up on string if too big
             }
+
+            ++count;
         }
 
         if (count > 0)
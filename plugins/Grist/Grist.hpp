@@ -9,26 +9,55 @@
 #define GRIST_HPP_INCLUDED
 
 #include "DistrhoPlugin.hpp"
+#include "extra/Runner.hpp"
+#include "DSP/CaptureRing.hpp"
+#include "DSP/GrainPool.hpp"
+#include "DSP/GrainInterp.hpp"
+#include "DSP/GrainKernel.hpp"
+#include "DSP/MappedFile.hpp"
+#include "DSP/MemoryLock.hpp"
+#include "DSP/PeakPyramid.hpp"
+#include "DSP/SampleAnalysis.hpp"
+#include "DSP/SampleCache.hpp"
+#include "DSP/SampleDiskCache.hpp"
+#include "DSP/SampleMips.hpp"
+#include "DSP/SampleStream.hpp"
 
 #include <vector>
 #include <mutex>
 #include <string>
 #include <memory>
+#include <atomic>
 
 START_NAMESPACE_DISTRHO
 
 class Grist : public Plugin {
 public:
     Grist();
+    ~Grist() override;
+
+    // UI thread (direct access): waveform overview of the current sample, or nullptr while
+    // none is built. `serial` changes whenever a new overview is published.
+    std::shared_ptr<const PeakPyramid> peakPyramid(uint32_t& serial);
+    uint32_t peakPyramidSerial() const { return peaksSerial.load(std::memory_order_acquire); }
 
 protected:
     // Plugin info
+#if GRIST_LIVE_INPUT
+    const char* getLabel() const override { return "GristLive"; }
+    const char* getDescription() const override { return "Live-input granulator (WIP)"; }
+#else
     const char* getLabel() const override { return "Grist"; }
     const char* getDescription() const override { return "Granular sample synth (WIP)"; }
+#endif
     const char* getMaker() const override { return "ArchieAudio"; }
     const char* getLicense() const override { return "ISC"; }
     uint32_t getVersion() const override { return d_version(0, 1, 0); }
+#if GRIST_LIVE_INPUT
+    int64_t getUniqueId() const override { return d_cconst('G','r','s','L'); }
+#else
     int64_t getUniqueId() const override { return d_cconst('G','r','i','s'); }
+#endif
 
     void initParameter(uint32_t index, Parameter& parameter) override;
     float getParameterValue(uint32_t index) const override;
@@ -59,6 +88,19 @@ private:
     float fReleaseMs;
     float fKillOnRetrig;        // 0/1 (DPF doesn't have bool params everywhere)
     float fNewVoiceOnRetrig;    // 0/1
+    float fWindowShape;         // GrainWindowShape index
+    float fSpawnMode;           // GrainSpawnMode index
+    float fLoudnessNorm;        // 0/1
+    float fNormThresholdDb;     // dBFS RMS below which normalised grains are dropped
+    float fSwapFadeMs;          // crossfade when a new sample replaces a playing one
+    float fInterpolation;       // GrainInterp index
+#if GRIST_LIVE_INPUT
+    float fFreeze;              // 0/1: stop writing the input into the capture ring
+    float fDrone;               // 0/1: keep a root-note voice playing without MIDI
+#endif
+    float fStreamMisses;        // output: page misses of the current streamed sample (every instance playing it)
+
+    static constexpr uint32_t kStateCount = GRIST_LIVE_INPUT ? 12 : 11;
 
     // Runtime
     double fSampleRate;
@@ -67,27 +109,206 @@ private:
     float currentVelocity; // 0..1
 
     struct SampleData {
-        std::vector<float> L;
-        std::vector<float> R;
+        // What the renderer reads: frame i of a channel is at L[i * stride] / R[i * stride],
+        // elements of SampleCodec<format>::Storage.
+        const void* L = nullptr;
+        const void* R = nullptr;
+        SampleFormat format = kSampleFloat32;
+        size_t stride = 1;
+        size_t frames = 0;
+        uint32_t channels = 2;  // 1: mono, stored once (R == L)
         uint32_t sampleRate = 0;
         std::string path;
+
+        // Backing storage: decoded planar channels (storageR empty for mono), the same packed
+        // to 16 bits (packedL/R, storageL/R then empty), or a mapping of a float32 WAV used in place.
+        std::vector<float> storageL;
+        std::vector<float> storageR;
+        std::vector<uint16_t> packedL;
+        std::vector<uint16_t> packedR;
+
+        // Octave mip levels 1..mipCount (decoded and disk-cached sources): level k is level k - 1
+        // low-passed and decimated by two, same format and planar layout as level 0. One block
+        // (mipStorage, mipPacked once packed, or the disk cache mapping) holds them all.
+        struct MipLevel {
+            const void* L = nullptr;
+            const void* R = nullptr;
+            size_t frames = 0;
+        };
+        uint32_t mipCount = 0;
+        MipLevel mips[kGrainMipLevels - 1];
+        std::vector<float> mipStorage;
+        std::vector<uint16_t> mipPacked;
+        MappedFile map;
+        size_t mapDataOffset = 0; // byte offset of frame 0 inside the mapping
+        bool diskCached = false;  // the mapping is a decoded-sample disk cache entry (planar)
+
+        // Streamed from disk instead (L/R unused): unmappable sources over the stream budget.
+        std::unique_ptr<SampleStream> stream;
+
+        // Live input instead: a capture ring (CaptureRing.hpp) of captureFrames stereo frames in
+        // storageL, written by the audio thread. L/R/stride/frames describe both of its copies.
+        float* capture = nullptr;
+        uint32_t captureFrames = 0;
+
+        // Prefaulted, page-locked part of the memory above ("lock_mb" state). A shared sample has
+        // one record: every instance that loads it raises it to its own budget, none lowers it
+        // (lockMutex). Declared last: it is unlocked before any of that memory is freed.
+        mutable std::mutex lockMutex;
+        mutable MemoryLock locked;
+        mutable size_t lockBudget = 0; // largest budget applied so far, bytes
+        mutable size_t lockWanted = 0; // bytes the budget covered
+        mutable size_t lockTotal = 0;  // bytes of sample memory (mapping, storage, mips or stream cache)
+        mutable int lockError = 0;     // errno of the first failed mlock
     };
 
-    std::mutex sampleMutex;
-    std::shared_ptr<const SampleData> sample; // swapped on load; held by audio thread per block
+    // Samples are shared between instances. A shared stream keeps one page cache and decoder;
+    // each instance attaches its own reader (audio-thread epoch and window).
+    typedef SharedSampleCache<SampleData> SampleCache;
 
-    // Grain engine (simple first pass)
-    struct Grain {
-        bool active = false;
-        double pos = 0.0;        // current sample index (fractional)
-        double startPos = 0.0;   // start sample index (fractional)
-        double inc = 1.0;        // playback increment per output sample
-        uint32_t age = 0;        // samples rendered
-        uint32_t dur = 0;        // duration in output samples
-        float panL = 1.0f;       // simple per-grain pan gains
-        float panR = 1.0f;
+    // --- wait-free sample hand-off ---
+    // The loader wraps each finished SampleData in a SampleRef and posts it to pendingSample.
+    // The audio thread takes it with a single exchange, keeps it as currentSample, and
+    // pushes the one it replaces onto retiredSamples. The loader deletes retired refs, so
+    // the audio thread never locks, allocates or frees during a swap.
+    // When the data itself changes, the grains already playing move to fadingGrains and keep
+    // reading the old data (fadingSample) while they fade out over the swap crossfade. New grains
+    // start at full level (their windows fade them in). A sample posted during a crossfade
+    // waits in queuedSample until it ends.
+    // Once the loader has analysed a sample it posts a second ref to the same data carrying
+    // the onset index.
+    // A ref to streamed data keeps this instance attached to the stream (SampleStream::Reader)
+    // for as long as the audio thread may hold it.
+    struct SampleRef {
+        std::shared_ptr<const SampleData> data;
+        std::shared_ptr<const SampleAnalysis> analysis; // null until analysed
+        const SampleStream::Reader* reader = nullptr;
+
+        SampleRef(const std::shared_ptr<const SampleData>& d, const SampleStream::Reader& r)
+            : data(d)
+        {
+            if (data->stream)
+            {
+                reader = &r;
+                data->stream->attach(r);
+            }
+        }
+        ~SampleRef()
+        {
+            if (reader != nullptr)
+                data->stream->detach(*reader);
+        }
+
+        SampleRef(const SampleRef&) = delete;
+        SampleRef& operator=(const SampleRef&) = delete;
     };
 
+    // Single-producer (audio thread) / single-consumer (loader thread) FIFO.
+    struct RetireQueue {
+        static constexpr uint32_t kSize = 16;
+        SampleRef* buf[kSize];
+        std::atomic<uint32_t> head {0}; // consumer position
+        std::atomic<uint32_t> tail {0}; // producer position
+
+        bool full() const {
+            return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) >= kSize;
+        }
+        bool push(SampleRef* r) {
+            const uint32_t t = tail.load(std::memory_order_relaxed);
+            if (t - head.load(std::memory_order_acquire) >= kSize) return false;
+            buf[t % kSize] = r;
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+        SampleRef* pop() {
+            const uint32_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) return nullptr;
+            SampleRef* const r = buf[h % kSize];
+            head.store(h + 1, std::memory_order_release);
+            return r;
+        }
+    };
+
+    std::atomic<SampleRef*> pendingSample {nullptr}; // loader -> audio mailbox
+    SampleRef* currentSample = nullptr;              // audio thread only
+    SampleRef* queuedSample = nullptr;               // audio thread: taken, not yet swapped in
+    SampleRef* fadingSample = nullptr;               // audio thread: what fadingGrains read
+    uint32_t fadeLength = 0;                         // audio thread: crossfade frames
+    uint32_t fadeRemaining = 0;
+    RetireQueue retiredSamples;                      // audio -> loader
+    std::atomic<bool> haveSample {false};            // any sample published yet (non-RT checks)
+
+    void publishSample(const std::shared_ptr<const SampleData>& s); // loader thread
+    void publishAnalysis(const std::shared_ptr<const SampleAnalysis>& a); // loader thread
+    void drainRetiredSamples();                                     // loader thread
+    const SampleData* acquireSample(uint32_t fadeFrames);           // audio thread, wait-free
+
+    // Mapped/streamed samples: the audio thread posts the range grains are spawning from, as
+    // fractions of the sample plus a reach in seconds, so each reader turns it into frames of
+    // the sample it serves (prefetchWindow). The loader thread turns it into madvise(WILLNEED)
+    // for mappings; the stream thread keeps the pages of streamed samples resident.
+    std::atomic<double> prefetchLo {0.0};
+    std::atomic<double> prefetchHi {0.0};
+    std::atomic<double> prefetchReach {0.0};
+    std::atomic<const SampleData*> playingSample {nullptr}; // what the audio thread rendered last
+    // During a swap crossfade from a streamed sample: the frames its remaining grains read,
+    // tagged with that sample (stored last).
+    std::atomic<uint64_t> fadePrefetchBegin {0};
+    std::atomic<uint64_t> fadePrefetchEnd {0};
+    std::atomic<const SampleData*> fadePrefetchFor {nullptr};
+    void prefetchWindow(const SampleData& s, uint64_t& begin, uint64_t& end) const;
+    uint64_t prefetchedBegin = 0; // loader thread: last range issued
+    uint64_t prefetchedEnd = 0;
+    void prefetchMappedSample(); // loader thread
+
+    // --- load-time resampling ---
+    std::atomic<double> targetRate {48000.0};       // host rate the loader converts to
+    std::atomic<bool> resampleOnLoad {true};        // "resample" state
+    std::atomic<uint32_t> publishedRate {0};        // rate of the last published sample data
+    std::atomic<bool> publishedInMemory {false};    // last published sample was decoded into RAM
+
+    // --- decoded-sample disk cache ---
+    std::atomic<bool> diskCacheOn {false};          // "disk_cache" state
+
+    // --- mipmaps for pitched-up grains ---
+    std::atomic<bool> mipmapsOn {true};             // "mipmaps" state
+
+    // --- resident sample memory ---
+    std::atomic<uint32_t> lockBudgetMb {0};         // "lock_mb" state; 0: no prefault/mlock
+    void lockSampleMemory(const SampleData& s);     // loader thread, before publishing (cache hits too)
+
+    // --- in-memory sample format ---
+    std::atomic<uint32_t> sampleFormat {kSampleFloat32}; // "sample_format" state (SampleFormat)
+
+    // --- disk streaming ---
+    std::atomic<uint32_t> streamCacheMb {0};        // "stream_cache_mb" state; 0 disables streaming
+    SampleStream::Reader streamRead;                // this instance's epoch on every stream it plays
+    std::mutex streamMutex;
+    std::shared_ptr<const SampleData> streamSample; // the stream thread's reference (streamMutex)
+    std::shared_ptr<const SampleData> fadingStreamSample; // the streamed sample streamSample replaced,
+                                                          // serviced until the audio thread lets go of it
+    void streamIdle();                              // stream thread
+
+#if GRIST_LIVE_INPUT
+    // --- live input ---
+    std::atomic<float> captureSeconds {8.0f};       // "capture_seconds" state
+    const SampleData* captureTarget = nullptr;      // audio thread: the ring being written
+    uint32_t captureHead = 0;                       // audio thread: next frame written
+    uint32_t captureFilled = 0;                     // audio thread: frames captured so far
+    int droneVoice = -1;                            // audio thread: voice held by Drone
+    bool createCaptureBuffer();                     // loader thread
+    void captureInput(const SampleData& s, const float* inL, const float* inR, uint32_t frames); // audio thread
+    void updateDrone();                             // audio thread
+#endif
+
+    // --- waveform overview and onset index (built by the loader after each load) ---
+    typedef SharedSampleCache<PeakPyramid> PeakCache;        // keyed by file identity only
+    typedef SharedSampleCache<SampleAnalysis> AnalysisCache; // positions are normalised: same key
+    std::mutex peaksMutex;
+    std::shared_ptr<const PeakPyramid> peaks;      // peaksMutex
+    std::atomic<uint32_t> peaksSerial {0};
+    void analyseSample(const SampleData& s);       // loader thread
+
     // Polyphonic voices
     struct Voice {
         bool active = false;
@@ -102,15 +323,43 @@ private:
         // per-note pitch envelope (semitones, decays toward 0)
         float pitchEnv = 0.0f;
 
-        // per-voice grain scheduling
-        static constexpr uint32_t kMaxGrains = 16;
-        Grain grains[kMaxGrains];
+        // per-voice grain scheduling (grains themselves live in the shared pool):
+        // time of the next grain onset, in frames from the start of the next spawn timeline
         double samplesToNextGrain = 0.0;
     };
 
     static constexpr uint32_t kMaxVoices = 16;
     Voice voices[kMaxVoices];
 
+    // Instance-wide grain pool shared by all voices
+    static constexpr uint32_t kGrainPoolCapacity = 1024;
+    GrainPool grains;
+    GrainPool fadingGrains;    // grains of the replaced sample during a swap crossfade
+    GrainKernels grainKernels; // selected once by CPU feature
+
+    // Grain onsets of the next few frames, computed up front per timeline span
+    // (sorted by frame, then voice). `lead` is the sub-sample part: how far past
+    // its onset the grain already is at its first rendered frame.
+    struct SpawnEvent {
+        uint32_t frame;
+        uint32_t voice;
+        float lead;
+    };
+    static constexpr uint32_t kSpawnTimelineFrames = 256;
+    static constexpr uint32_t kMaxSpawnEvents = kMaxVoices * 4; // density <= 80 gr/s: at most 2 per voice per span
+    SpawnEvent spawnTimeline[kMaxSpawnEvents];
+    uint32_t spawnCount = 0;
+
+    // Render scratch for one span between spawn events (at most one timeline span): grains
+    // are rendered grain by grain into their voice's bus, then each bus is scaled by that
+    // voice's envelope and summed into the output.
+    float voiceBusL[kMaxVoices][kSpawnTimelineFrames];
+    float voiceBusR[kMaxVoices][kSpawnTimelineFrames];
+    float voiceEnv[kMaxVoices][kSpawnTimelineFrames]; // fGain * velocity * env per frame
+    float fadeMixL[kSpawnTimelineFrames];             // fadingGrains' mix during a swap crossfade
+    float fadeMixR[kSpawnTimelineFrames];
+    static_assert(kMaxVoices <= 32, "voice masks are 32-bit");
+
     // Per-midi-note voice queues (for New Voice mode note-off matching)
     struct NoteQueue {
         int buf[kMaxVoices];
@@ -164,11 +413,95 @@ private:
     uint32_t vizEventCount = 0;
     uint32_t vizDecim = 0;
 
+    // Per-block render constants (derived from parameters once per run() call)
+    struct BlockParams {
+        uint32_t grainDur;
+        double density;
+        double samplesPerGrain;
+        float attackInc;
+        float releaseDec;
+        float pitchStep;
+        double srMul;
+        const float* window;     // GrainWindowTable data for the selected shape
+        const SampleAnalysis* analysis; // onset index of the current sample, or nullptr
+        uint32_t spawnMode;      // GrainSpawnMode
+        GrainInterp interp;
+        bool loudnessNorm;
+        float normFloor;         // mean-square threshold (fNormThresholdDb)
+    };
+
+    // Loudness-normalised grains are levelled to this RMS, boosting by at most kMaxLoudnessGain.
+    static constexpr float kLoudnessTarget = 0.25f;  // -12 dBFS
+    static constexpr float kMaxLoudnessGain = 16.0f; // +24 dB
+
+    // MIDI handling (applied at the event's frame offset)
+    int findVoiceForNote(int note) const;
+    int allocVoice() const;
+    void removeVoiceFromQueues(int v);
+    void handleMidiEvent(const MidiEvent& ev);
+
+    // Renders `frames` samples into outL/outR; no MIDI is processed inside.
+    // `fading` is the replaced sample while a swap crossfade runs, else nullptr.
+    void renderFrames(const SampleData& s, const SampleData* fading, const BlockParams& bp,
+                      float* outL, float* outR, uint32_t frames);
+    void buildSpawnTimeline(const BlockParams& bp, uint32_t begin, uint32_t end);
+    void spawnGrain(const SampleData& s, const BlockParams& bp, uint32_t v, float lead);
+    uint32_t updateVoiceEnvelopes(const BlockParams& bp, uint32_t frames);
+    uint32_t renderGrainSpan(GrainPool& pool, GrainKernelFn kernel, const GrainKernelArgs& ka,
+                             const GrainPhase* lastPos, uint32_t frames, float* mixL, float* mixR);
+    GrainKernelFn bindGrainKernel(const SampleData& s, GrainInterp interp, GrainKernelArgs& ka, GrainPhase* lastPos) const;
+
     double midiNoteToHz(int note) const;
     bool loadWavFile(const char* path);
+    bool mapFloatWavFile(const char* path, uint32_t channels, uint32_t sampleRate,
+                         uint64_t frames, uint64_t dataOffset); // zero-copy float32 path
+    bool openStreamedFile(const char* path, size_t cacheBytes);
+    bool mapDiskCachedSample(const char* path, const std::string& cacheKey);
+    bool resampleStorage(SampleData& s, uint32_t outRate, int& lastPercent);
+    void packStorage(SampleData& s, SampleFormat format);
+    bool buildMipLevels(SampleData& s);
+    static void bindMipLevels(SampleData& s, const void* block, uint32_t count);
     bool loadDefaultSample();
 
-    // Non-RT load diagnostics (used to report failures to UI)
+    // --- background sample loading ---
+    // setState()/activate() only queue a request; decoding runs on the loader thread.
+    class SampleLoader : public Runner {
+    public:
+        explicit SampleLoader(Grist& g) : Runner("grist-loader"), owner(g) {}
+    protected:
+        bool run() override { owner.loaderIdle(); return true; }
+    private:
+        Grist& owner;
+    };
+
+    std::mutex requestMutex;                 // guards pendingPath (non-RT threads only)
+    std::string pendingPath;                 // latest requested file ("__DEFAULT__" = default sample)
+    std::string loadedPath;                  // file of the last successful load
+    std::atomic<uint32_t> requestSerial {0}; // bumped per request; a newer serial cancels a running load
+    std::atomic<uint32_t> completedSerial {0}; // last request the loader finished (ok or error)
+    uint32_t loaderSerial = 0;               // loader thread: serial of the request being handled
+    std::shared_ptr<const SampleData> loaderSample; // loader thread: last published sample
+    SampleLoader loader;
+
+    // Keeps the pages of a streamed sample resident; separate from the loader so a
+    // long decode never starves playback.
+    class StreamReader : public Runner {
+    public:
+        explicit StreamReader(Grist& g) : Runner("grist-stream"), owner(g) {}
+    protected:
+        bool run() override { owner.streamIdle(); return true; }
+    private:
+        Grist& owner;
+    };
+    StreamReader streamReader;
+
+    void requestSampleLoad(const char* path);
+    void reloadCurrentSample();
+    void loaderIdle();
+    bool loadCancelled() const;
+    void reportLoadProgress(uint64_t done, uint64_t total, int& lastPercent);
+
+    // Non-RT load diagnostics (used to report failures to UI), loader thread only
     std::string lastSampleError;
 
     // Random helpers
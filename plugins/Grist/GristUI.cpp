@@ -4,6 +4,7 @@
 
 #include "GristUI.hpp"
 #include "GristVizBus.hpp"
+#include "Grist.hpp"
 
 #include <algorithm>
 #include <cmath>
@@ -11,8 +12,6 @@
 #include <cstring>
 #include <cstdlib>
 
-#include "DSP/dr_wav.h"
-
 static inline float fclampf(const float v, const float lo, const float hi)
 {
     return v < lo ? lo : (v > hi ? hi : v);
@@ -177,62 +176,14 @@ void GristUI::rebuildWavePeaks()
     waveMin.clear();
     waveMax.clear();
 
-    if (samplePath.empty() || waveW < 4.0f)
-        return;
-
-    drwav wav;
-    if (!drwav_init_file(&wav, samplePath.c_str(), nullptr))
+    if (!wavePeaks || waveW < 4.0f)
         return;
 
-    const uint32_t ch = wav.channels;
-    const uint64_t frames = wav.totalPCMFrameCount;
-    if (frames < 2 || ch < 1)
-    {
-        drwav_uninit(&wav);
-        return;
-    }
-
+    // served from the DSP's peak pyramid: no file access here
     const uint32_t cols = (uint32_t)std::max(8.0f, std::floor(waveW));
     waveMin.assign(cols, 0.0f);
     waveMax.assign(cols, 0.0f);
-
-    // Read in chunks to avoid huge allocations
-    const uint32_t chunkFrames = 4096;
-    std::vector<float> buf;
-    buf.resize((size_t)chunkFrames * ch);
-
-    uint64_t frameIndex = 0;
-    while (frameIndex < frames)
-    {
-        const uint64_t toRead = std::min<uint64_t>(chunkFrames, frames - frameIndex);
-        const uint64_t got = drwav_read_pcm_frames_f32(&wav, toRead, buf.data());
-        if (got == 0)
-            break;
-
-        for (uint64_t i = 0; i < got; ++i)
-        {
-            float s = buf[(size_t)i * ch];
-            if (ch > 1)
-                s = 0.5f * (s + buf[(size_t)i * ch + 1]);
-
-            const uint64_t global = frameIndex + i;
-            const uint32_t col = (uint32_t)std::min<uint64_t>(cols - 1, (global * cols) / frames);
-            if (global == 0)
-            {
-                waveMin[col] = s;
-                waveMax[col] = s;
-            }
-            else
-            {
-                waveMin[col] = std::min(waveMin[col], s);
-                waveMax[col] = std::max(waveMax[col], s);
-            }
-        }
-
-        frameIndex += got;
-    }
-
-    drwav_uninit(&wav);
+    wavePeaks->columns(0, wavePeaks->frameCount(), cols, waveMin.data(), waveMax.data());
 }
 
 void GristUI::parameterChanged(uint32_t index, float value)
@@ -253,6 +204,17 @@ void GristUI::uiIdle()
 {
     bool changed = false;
 
+    // waveform overview: the DSP publishes a new peak pyramid after each load
+    if (Grist* const dsp = static_cast<Grist*>(getPluginInstancePointer()))
+    {
+        if (dsp->peakPyramidSerial() != wavePeaksSerial)
+        {
+            wavePeaks = dsp->peakPyramid(wavePeaksSerial);
+            rebuildWavePeaks();
+            changed = true;
+        }
+    }
+
     // Pull viz data from in-process bus (needed for CLAP backend)
     uint32_t sc = 0;
     float sp[GristVizBus::kMaxSpawn];
@@ -297,7 +259,6 @@ void GristUI::stateChanged(const char* key, const char* value)
             const char* lastSlash = std::strrchr(value, '/');
             const char* name = lastSlash ? (lastSlash + 1) : value;
             std::snprintf(sampleLabel, sizeof(sampleLabel), "Sample: %s", name);
-            rebuildWavePeaks();
         }
         else
         {
@@ -330,6 +291,11 @@ void GristUI::stateChanged(const char* key, const char* value)
         {
             // keep label as-is; error text will come via sample_error
         }
+        else if (value && std::strncmp(value, "loading", 7) == 0)
+        {
+            // background load in progress ("loading" or "loading NN%")
+            std::snprintf(sampleLabel, sizeof(sampleLabel), "Loading%s", value + 7);
+        }
         repaint();
         return;
     }
@@ -7,7 +7,9 @@
 
 #include "DistrhoUI.hpp"
 #include "DistrhoPluginInfo.h"
+#include "DSP/PeakPyramid.hpp"
 
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -62,6 +64,8 @@ private:
     float waveH = 110.0f;
 
     std::string samplePath;
+    std::shared_ptr<const PeakPyramid> wavePeaks; // shared with the DSP, read-only
+    uint32_t wavePeaksSerial = 0;
     std::vector<float> waveMin; // per-column min
     std::vector<float> waveMax; // per-column max
 
@@ -0,0 +1,16 @@
+/*
+ * Grist Live — live-input variant of Grist
+ * Copyright (C) 2026
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted.
+ */
+
+#ifndef GRIST_LIVE_PLUGIN_INFO_H_INCLUDED
+#define GRIST_LIVE_PLUGIN_INFO_H_INCLUDED
+
+// Same plugin, built with a stereo input that grains read through a capture ring
+#define GRIST_LIVE_INPUT 1
+#include "../Grist/DistrhoPluginInfo.h"
+
+#endif // GRIST_LIVE_PLUGIN_INFO_H_INCLUDED
@@ -0,0 +1,7 @@
+/*
+ * Grist Live — DSP
+ *
+ * The Grist sources compiled with GRIST_LIVE_INPUT (see DistrhoPluginInfo.h).
+ */
+
+#include "../Grist/Grist.cpp"
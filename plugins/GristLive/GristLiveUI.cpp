@@ -0,0 +1,7 @@
+/*
+ * Grist Live — UI
+ *
+ * The Grist UI compiled with GRIST_LIVE_INPUT (see DistrhoPluginInfo.h).
+ */
+
+#include "../Grist/GristUI.cpp"
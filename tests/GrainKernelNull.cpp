@@ -0,0 +1,250 @@
+/*
+ * Grist — Grain kernel null test
+ *
+ * Renders one pool of random grains (increments, start positions, windows,
+ * pans, mip levels) through grainKernelScalar and through every SIMD kernel
+ * table the host supports, for each interpolation mode, sample format, and
+ * mono / planar stereo / interleaved stereo source, and checks that the
+ * outputs and the advanced grain state match within kTolerance.
+ *
+ * Build and run with `make test` from the repo root.
+ */
+
+#include "GrainKernel.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static constexpr uint32_t kSourceFrames = 4096;
+static constexpr uint32_t kGrains = 64;
+static constexpr uint32_t kMaxSpan = 700;
+
+// Largest allowed |scalar - simd| on any output frame. The kernels do the same float
+// operations per frame, so on x86 they match exactly; the margin allows for compilers
+// that contract multiply-adds differently per instruction set.
+static constexpr double kTolerance = 1e-6;
+
+struct Layout {
+    const char* name;
+    uint32_t channels;
+    size_t stride;
+};
+
+static const Layout kLayouts[] = {
+    { "mono", 1, 1 },
+    { "stereo planar", 2, 1 },
+    { "stereo interleaved", 2, 2 },
+};
+
+static const char* const kInterpNames[kInterpModeCount] = { "linear", "cubic", "sinc8", "sinc16", "auto" };
+
+// Source audio in every format, planar (L then R) and interleaved.
+struct Source {
+    std::vector<float> planarF[2], interF;
+    std::vector<int16_t> planarI[2], interI;
+    std::vector<uint16_t> planarH[2], interH;
+
+    explicit Source(std::mt19937& rng)
+    {
+        std::uniform_real_distribution<float> u(-0.9f, 0.9f);
+        std::vector<float> ch[2];
+        for (uint32_t c = 0; c < 2; ++c)
+        {
+            ch[c].resize(kSourceFrames);
+            for (uint32_t i = 0; i < kSourceFrames; ++i)
+                ch[c][i] = u(rng);
+        }
+
+        for (uint32_t c = 0; c < 2; ++c)
+        {
+            planarF[c] = ch[c];
+            planarI[c].resize(kSourceFrames);
+            planarH[c].resize(kSourceFrames);
+            for (uint32_t i = 0; i < kSourceFrames; ++i)
+            {
+                planarI[c][i] = floatToInt16(ch[c][i]);
+                planarH[c][i] = floatToHalf(ch[c][i]);
+            }
+        }
+
+        interF.resize(kSourceFrames * 2);
+        interI.resize(kSourceFrames * 2);
+        interH.resize(kSourceFrames * 2);
+        for (uint32_t i = 0; i < kSourceFrames; ++i)
+            for (uint32_t c = 0; c < 2; ++c)
+            {
+                interF[i * 2 + c] = planarF[c][i];
+                interI[i * 2 + c] = planarI[c][i];
+                interH[i * 2 + c] = planarH[c][i];
+            }
+    }
+
+    void bind(SampleFormat format, const Layout& layout, GrainKernelArgs& a) const
+    {
+        const void* L;
+        const void* R;
+        if (layout.stride == 2)
+        {
+            L = format == kSampleFloat32 ? (const void*)interF.data()
+              : format == kSampleInt16 ? (const void*)interI.data() : (const void*)interH.data();
+            R = format == kSampleFloat32 ? (const void*)(interF.data() + 1)
+              : format == kSampleInt16 ? (const void*)(interI.data() + 1) : (const void*)(interH.data() + 1);
+        }
+        else
+        {
+            const uint32_t r = layout.channels == 2 ? 1 : 0;
+            L = format == kSampleFloat32 ? (const void*)planarF[0].data()
+              : format == kSampleInt16 ? (const void*)planarI[0].data() : (const void*)planarH[0].data();
+            R = format == kSampleFloat32 ? (const void*)planarF[r].data()
+              : format == kSampleInt16 ? (const void*)planarI[r].data() : (const void*)planarH[r].data();
+        }
+
+        // every mip level reads the same data: levels only change which pointer a grain uses
+        for (uint32_t k = 0; k < kGrainMipLevels; ++k)
+        {
+            a.L[k] = L;
+            a.R[k] = R;
+            a.len[k] = kSourceFrames;
+        }
+        a.stride = layout.stride;
+    }
+};
+
+// Random grains, each with the number of frames it can render without leaving the source.
+static void makeGrains(std::mt19937& rng, GrainPool& pool, std::vector<uint32_t>& span)
+{
+    std::uniform_real_distribution<double> u01(0.0, 1.0);
+    const uint32_t shapes = kWindowShapeCount;
+    const GrainPhase last = grainPhaseFromIndex(kSourceFrames - 1);
+
+    span.assign(kGrains, 0);
+    for (uint32_t n = 0; n < kGrains; ++n)
+    {
+        const uint32_t g = (uint32_t)pool.alloc();
+
+        // some grains at unit rate on a whole frame, some starting at the source edges
+        const bool unit = n % 5 == 0;
+        double start = u01(rng) * (kSourceFrames / 2);
+        if (n % 7 == 1)
+            start = u01(rng) * 8.0;
+        else if (n % 7 == 2)
+            start = kSourceFrames - 40.0 + u01(rng) * 8.0;
+        const double inc = unit ? 1.0 : 0.25 + u01(rng) * 2.75;
+
+        pool.pos[g] = unit ? grainPhaseFromIndex((uint64_t)start) : grainPhaseFromFrames(start);
+        pool.startPos[g] = pool.pos[g];
+        pool.inc[g] = grainPhaseFromFrames(inc);
+        pool.interp[g] = grainInterpForIncrement(pool.inc[g]);
+        pool.level[g] = n % kGrainMipLevels;
+        pool.dur[g] = 16 + (uint32_t)(u01(rng) * (kMaxSpan - 16));
+        pool.age[g] = 0;
+        pool.winInc[g] = GrainWindowTable::stepForDuration(pool.dur[g]);
+        pool.winPos[g] = pool.winInc[g] * (float)u01(rng);
+        const float ang = (float)u01(rng) * 1.57079632679f;
+        pool.gainL[g] = std::cos(ang) * 0.5f;
+        pool.gainR[g] = std::sin(ang) * 0.5f;
+        pool.voice[g] = n % shapes; // unused by the kernels; picks the window shape below
+
+        const GrainPhase inc64 = pool.inc[g];
+        const uint64_t toEnd = (last - pool.pos[g] + inc64 - 1) / inc64;
+        span[g] = (uint32_t)std::min<uint64_t>(pool.dur[g], toEnd);
+    }
+}
+
+// Renders every grain of a copy of `pool` and returns the output and the advanced state.
+static void render(GrainKernelFn kernel, const GrainPool& pool, const std::vector<uint32_t>& span,
+                   GrainKernelArgs a, std::vector<float>& outL, std::vector<float>& outR, GrainPool& after)
+{
+    after = pool;
+    outL.assign(kMaxSpan, 0.0f);
+    outR.assign(kMaxSpan, 0.0f);
+    for (uint32_t g = 0; g < after.activeCount(); ++g)
+    {
+        a.window = GrainWindowTable::instance().data(after.voice[g]);
+        kernel(after, g, a, span[g], outL.data(), outR.data());
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(0x6a1e);
+    const Source source(rng);
+
+    GrainPool pool(kGrains);
+    std::vector<uint32_t> span;
+    makeGrains(rng, pool, span);
+
+    struct Table {
+        const char* name;
+        GrainKernels kernels;
+    };
+    std::vector<Table> tables;
+#if defined(GRAIN_KERNEL_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+        tables.push_back({ "sse2", GRAIN_KERNEL_TABLE(grainKernelSSE2) });
+    if (__builtin_cpu_supports("avx2"))
+        tables.push_back({ "avx2", GRAIN_KERNEL_TABLE(grainKernelAVX2) });
+#elif defined(GRAIN_KERNEL_NEON)
+    tables.push_back({ "neon", GRAIN_KERNEL_TABLE(grainKernelNEON) });
+#endif
+    const GrainKernels scalar = GRAIN_KERNEL_TABLE(grainKernelScalar);
+
+    if (tables.empty())
+    {
+        std::printf("no SIMD kernels on this host: nothing to compare\n");
+        return 0;
+    }
+
+    GrainKernelArgs a = {};
+    a.sinc = &GrainSincTables::instance();
+
+    uint32_t failures = 0;
+    std::vector<float> refL, refR, outL, outR;
+    GrainPool refPool(kGrains), outPool(kGrains);
+
+    for (uint32_t m = 0; m < kInterpModeCount; ++m)
+        for (uint32_t f = 0; f < kSampleFormatCount; ++f)
+            for (const Layout& layout : kLayouts)
+            {
+                const GrainInterp interp = (GrainInterp)m;
+                const SampleFormat format = (SampleFormat)f;
+                source.bind(format, layout, a);
+                render(scalar.select(interp, format, layout.channels), pool, span, a, refL, refR, refPool);
+
+                for (const Table& t : tables)
+                {
+                    render(t.kernels.select(interp, format, layout.channels), pool, span, a, outL, outR, outPool);
+
+                    double maxDiff = 0.0;
+                    for (uint32_t k = 0; k < kMaxSpan; ++k)
+                    {
+                        maxDiff = std::max(maxDiff, (double)std::fabs(refL[k] - outL[k]));
+                        maxDiff = std::max(maxDiff, (double)std::fabs(refR[k] - outR[k]));
+                    }
+
+                    bool stateOk = true;
+                    for (uint32_t g = 0; g < kGrains; ++g)
+                        stateOk = stateOk && refPool.pos[g] == outPool.pos[g] && refPool.age[g] == outPool.age[g]
+                                          && refPool.winPos[g] == outPool.winPos[g];
+
+                    const bool ok = maxDiff <= kTolerance && stateOk;
+                    if (!ok)
+                        ++failures;
+                    std::printf("%-4s %-6s %-6s %-18s %-6s max diff %.3g%s\n", ok ? "ok" : "FAIL", kInterpNames[m],
+                                sampleFormatName(format), layout.name, t.name, maxDiff,
+                                stateOk ? "" : ", grain state differs");
+                }
+            }
+
+    if (failures != 0)
+    {
+        std::printf("%u case(s) over tolerance %.3g\n", failures, kTolerance);
+        return EXIT_FAILURE;
+    }
+    std::printf("all kernels within %.3g of scalar\n", kTolerance);
+    return EXIT_SUCCESS;
+}